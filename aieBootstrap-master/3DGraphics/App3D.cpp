@@ -7,7 +7,15 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <Gizmos.h>
+#include <ProgramCache.h>
 #include <glm/gtx/transform.hpp>
+#include "UploadQueue.h"
+
+/*
+	\var const float UPLOAD_BUDGET
+	The time in milliseconds that can be spent each frame creating the buffers and textures of assets loaded in the background.
+*/
+const float UPLOAD_BUDGET = 2.0f;
 
 /*
 	\fn App3D()
@@ -36,32 +44,24 @@ bool App3D::startup()
 	m_camera->LookAt(glm::vec3(10.0f, 10.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 	m_camera->Perspective(glm::pi<float>() * 0.25f, 1280.0f / 720.0f, 0.1f, 100.0f);
 
-	// loads the phong shader from the bin folder and attempts to link it
+	// keeps the compiled shader programs beside the shaders so later runs can skip compiling them
+	aie::ProgramCache::setFolder("../bin/shaders/");
+
+	// loads the phong and simple shaders from the bin folder
 	m_phongShader.loadShader(aie::eShaderStage::VERTEX, "../bin/shaders/phong.vert");
 	m_phongShader.loadShader(aie::eShaderStage::FRAGMENT, "../bin/shaders/phong.frag");
-	if (m_phongShader.link() == false)
-	{
-		// prints an error if the shader failed to load
-		printf("Phong Shader Error!\n", m_phongShader.getLastError());
-		return false;
-	}
-	// loads the simple shader from the bin folder and attempts to link it
 	m_simpleShader.loadShader(aie::eShaderStage::VERTEX, "../bin/shaders/simpleColour.vert");
 	m_simpleShader.loadShader(aie::eShaderStage::FRAGMENT, "../bin/shaders/simpleColour.frag");
-	if (m_simpleShader.link() == false)
-	{
-		// prints an error if the shader failed to load
-		printf("Colour Shader Error!\n", m_simpleShader.getLastError());
-		return false;
-	}
-
-	// attempts to load the spear mesh with textures
-	if (m_spearMesh.load("../bin/soulspear/soulspear.obj", true, true) == false)
-	{
-		// prints an error if it failed to load
-		printf("Soulspear Mesh Error!\n");
-		return false;
-	}
+	// starts linking both at once so the driver can compile them side by side while the rest starts up, they are checked at the end
+	aie::ShaderProgram* shaders[] = { &m_phongShader, &m_simpleShader };
+	aie::ShaderProgram::linkAll(shaders, 2);
+
+	// the spear is stored with quantised vertices, which the phong shader unpacks
+	m_spearMesh.setVertexFormat(aie::OBJMesh::PACKED_VERTEX);
+	// starts loading the spear mesh with textures in the background, it is drawn as its pieces are uploaded
+	aie::OBJMesh::LoadOptions spearOptions;
+	spearOptions.flipTextureV = true;
+	m_spearLoad = m_spearMesh.loadAsync("../bin/soulspear/soulspear.obj", spearOptions);
 	// initialises the transform of the spear to have a scale of 200%
 	m_spearTransform = { 2.0f, 0.0f, 0.0f, 0.0f,
 						 0.0f, 2.0f, 0.0f, 0.0f,
@@ -73,14 +73,14 @@ bool App3D::startup()
 	m_mesh->AddPyramid(glm::vec3(-4.0f, 0.0f, 10.0f), 1.0f, 1.0f, glm::vec4(0.0f, 1.0f, 1.0f, 1.0f));
 
 	// cyan point light with little loss in light over distance
-	Light pointLight;
+	aie::Light pointLight;
 	pointLight.position = glm::vec4(-4.0f, 0.0f, 10.0f, 1.0f);
 	pointLight.Ia = glm::vec3(0.25f);
 	pointLight.Id = glm::vec3(0.0f, 1.0f, 1.0f);
 	pointLight.Is = glm::vec3(0.0f, 1.0f, 1.0f);
 	pointLight.attenuation = 0.05f;
 	// yellow directional light
-	Light directionalLight;
+	aie::Light directionalLight;
 	directionalLight.position = glm::vec4(-4.0f, 0.0f, 10.0f, 0.0f);
 	directionalLight.Ia = glm::vec3(0.25f);
 	directionalLight.Id = glm::vec3(1.0f, 1.0f, 0.0f);
@@ -90,6 +90,20 @@ bool App3D::startup()
 	m_lights.push_back(pointLight);
 	m_lights.push_back(directionalLight);
 
+	// waits for the shaders to finish linking
+	if (m_phongShader.finishLink() == false)
+	{
+		// prints an error if the shader failed to load
+		printf("Phong Shader Error!\n%s\n", m_phongShader.getLastError());
+		return false;
+	}
+	if (m_simpleShader.finishLink() == false)
+	{
+		// prints an error if the shader failed to load
+		printf("Colour Shader Error!\n%s\n", m_simpleShader.getLastError());
+		return false;
+	}
+
 	return true;
 }
 /*
@@ -107,6 +121,7 @@ void App3D::shutdown()
 /*
 	\fn void update(float deltaTime)
 	\brief Updates the camera each frame and makes an orbiting "sun" by moving the directional light around.
+	\brief Also ends the game loop if the spear failed to load in the background.
 	\param deltaTime The time between each frame.
 */
 void App3D::update(float deltaTime)
@@ -120,6 +135,18 @@ void App3D::update(float deltaTime)
 
 	m_camera->Update(deltaTime);
 
+	// checks if the spear has finished loading
+	if (m_spearLoad.valid() && m_spearLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		if (m_spearLoad.get() == false)
+		{
+			// prints an error if it failed to load and ends the game loop
+			printf("Soulspear Mesh Error!\n");
+			m_gameOver = true;
+		}
+		m_spearLoad = std::shared_future<bool>();
+	}
+
 	// directional light orbits the center of the area
 	float time = getTime();
 	// for directional lights the position property is proportional to the direction of the light
@@ -131,6 +158,9 @@ void App3D::update(float deltaTime)
 */
 void App3D::draw()
 {
+	// starts counting the chunks drawn and culled, and the material switches, for this frame
+	aie::OBJMesh::resetDrawStats();
+
 	// adds 3 coloured lines to the scene to represent the axis of the world space
 	aie::Gizmos::addTransform(glm::mat4(1.0f));
 
@@ -159,20 +189,16 @@ void App3D::draw()
 	m_phongShader.bindUniform("ProjectionViewModel", pv * m_spearTransform);
 	m_phongShader.bindUniform("ModelMatrix", m_camera->GetModel());
 	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_spearTransform)));
-	m_phongShader.bindUniform("numLights", (int)m_lights.size());
 	m_phongShader.bindUniform("cameraPosition", glm::vec3(m_camera->GetModel()[3]));
 
-	// binds the property for each light in the collection
-	for (size_t i = 0; i < m_lights.size(); i++)
-	{
-		SetLightUniform(&m_phongShader, "position", i, m_lights[i].position);
-		SetLightUniform(&m_phongShader, "Ia", i, m_lights[i].Ia);
-		SetLightUniform(&m_phongShader, "Id", i, m_lights[i].Id);
-		SetLightUniform(&m_phongShader, "Is", i, m_lights[i].Is);
-		SetLightUniform(&m_phongShader, "attenuation", i, m_lights[i].attenuation);
-	}
-	// draws the model
-	m_spearMesh.draw();
+	// bins the lights by the parts of the view they reach
+	m_lightClusters.build(m_lights.data(), m_lights.size(), m_camera->GetView(), m_camera->GetProjection(),
+		glm::vec2((float)getWindowWidth(), (float)getWindowHeight()));
+	// copies every light and the lights of each part of the view in to the light buffer and binds it for the phong shader
+	m_lightBuffer.update(m_lights.data(), m_lights.size(), &m_lightClusters);
+	m_lightBuffer.bind();
+	// draws the model at a level of detail suited to its size on screen, skipping the parts of it that are off screen or facing away from the camera
+	m_spearMesh.drawLOD(m_spearTransform, m_camera->GetProjection(), m_camera->GetView(), (float)getWindowHeight());
 
 	// draws the point light in the same way that the spear is drawn
 	m_simpleShader.bind();
@@ -239,6 +265,9 @@ void App3D::RunApp()
 	// creates a gizmo instance
 	aie::Gizmos::create(32768, 32768, 256, 256);
 
+	// prints how long the shader programs took to load or compile
+	aie::ProgramCache::printStats();
+
 	// variables for timing
 	double prevTime = glfwGetTime();
 	double currTime = 0;
@@ -261,6 +290,9 @@ void App3D::RunApp()
 		deltaTime = currTime - prevTime;
 		prevTime = currTime;
 
+		// creates the buffers and textures of assets that finished loading in the background
+		aie::UploadQueue::process(UPLOAD_BUDGET);
+
 		// passes delta time into the update
 		update(float(deltaTime));
 		// draws everything in the application
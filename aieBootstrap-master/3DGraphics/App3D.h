@@ -12,7 +12,9 @@
 #include "Shader.h"
 #include "Mesh.h"
 #include "OBJMesh.h"
-#include <sstream>
+#include "LightBuffer.h"
+#include "LightClusters.h"
+#include <future>
 
 /*
 	\class App3D
@@ -59,52 +61,7 @@ public:
 	*/
 	void RunApp();
 
-	/*
-		\fn void SetLightUniform(aie::ShaderProgram* shader, const char* propertyName, size_t lightIndex, const T& value)
-		\brief This function is templated with type name T.
-		\brief Binds the uniform of the specified light property.
-		\param shader The shader that the uniform is being bound for.
-		\param propertyName The name of the shader light property that will be bound.
-		\param lightIndex The index of the light in the array of lights.
-		\tparam value The value that the bound uniform is being set to.
-	*/
-	template <typename T>
-	void SetLightUniform(aie::ShaderProgram* shader, const char* propertyName, size_t lightIndex, const T& value)
-	{
-		// the string stream that will become the name of the uniform being bound to
-		std::ostringstream ss;
-		// concatenates the light index and property name to the uniform name
-		ss << "allLights[" << lightIndex << "]." << propertyName;
-		std::string uniformName = ss.str();
-
-		// binds the uniform and sets its value
-		shader->bindUniform(uniformName.c_str(), value);
-	}
-
 protected:
-	/*
-		\struct Light
-		\brief An object that emits light.
-		\var glm::vec4 position
-		The position of the light.
-		\var glm::vec3 Ia
-		The ambient colour of the light.
-		\var glm::vec3 Id
-		The diffuse colour of the light.
-		\var glm::vec3 Is
-		The specular colour of the light.
-		\var float attenuation
-		The reduction of the intensity of the light over distance.
-	*/
-	struct Light
-	{
-		glm::vec4 position;
-		glm::vec3 Ia;
-		glm::vec3 Id;
-		glm::vec3 Is;
-		float attenuation;
-	};
-
 	/*
 		\var Camera* m_camera
 		The camera in the scene.
@@ -114,18 +71,27 @@ protected:
 		The shader used to render the light objects.
 		\var aie::OBJMesh m_spearMesh
 		The mesh of the soul spear.
+		\var std::shared_future<bool> m_spearLoad
+		Becomes ready once the soul spear has finished loading in the background.
 		\var glm::mat4 m_spearTransform
 		The transform of the soul spear.
 		\var Mesh m_mesh
 		The mesh of the light objects.
-		\var std::vector<Light> m_lights
+		\var std::vector<aie::Light> m_lights
 		A collection of the lights in the application.
+		\var aie::LightBuffer m_lightBuffer
+		The buffer the phong shader reads the lights from, filled once a frame.
+		\var aie::LightClusters m_lightClusters
+		The lights that reach each part of the view, so each pixel only shades the lights near it.
 	*/
 	Camera* m_camera;
 	aie::ShaderProgram m_phongShader;
 	aie::ShaderProgram m_simpleShader;
 	aie::OBJMesh m_spearMesh;
+	std::shared_future<bool> m_spearLoad;
 	glm::mat4 m_spearTransform;
 	Mesh* m_mesh;
-	std::vector<Light> m_lights;
+	std::vector<aie::Light> m_lights;
+	aie::LightBuffer m_lightBuffer;
+	aie::LightClusters m_lightClusters;
 };
\ No newline at end of file
@@ -25,6 +25,25 @@ public:
 		radius = glm::distance(min, centre);
 	}
 
+	// grows the sphere just enough to also contain other
+	void merge(const BoundingSphere& other)
+	{
+		glm::vec3 offset = other.centre - centre;
+		float distance = glm::length(offset);
+		// other is already inside
+		if (distance + other.radius <= radius)
+			return;
+		// this is inside other
+		if (distance + radius <= other.radius)
+		{
+			*this = other;
+			return;
+		}
+		float mergedRadius = (distance + radius + other.radius) * 0.5f;
+		centre += offset * ((mergedRadius - radius) / distance);
+		radius = mergedRadius;
+	}
+
 	glm::vec3 centre;
 	float radius;
 };
\ No newline at end of file
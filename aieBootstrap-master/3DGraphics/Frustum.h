@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace aie {
+
+// the 6 clipping planes of a projection, pulled from the matrix so they are
+// in whatever space it transforms from (world space for a projection view,
+// model space for a projection view model)
+class Frustum {
+public:
+
+	Frustum() {}
+	Frustum(const glm::mat4& transform) { set(transform); }
+
+	void set(const glm::mat4& transform) {
+		glm::mat4 t = glm::transpose(transform);
+
+		m_planes[0] = t[3] + t[0];	// left
+		m_planes[1] = t[3] - t[0];	// right
+		m_planes[2] = t[3] + t[1];	// bottom
+		m_planes[3] = t[3] - t[1];	// top
+		m_planes[4] = t[3] + t[2];	// near
+		m_planes[5] = t[3] - t[2];	// far
+
+		// normalised so distances can be compared against a radius
+		for (auto& p : m_planes)
+			p /= glm::length(glm::vec3(p));
+	}
+
+	// false only when the sphere is entirely outside one of the planes
+	bool intersects(const glm::vec3& centre, float radius) const {
+		for (auto& p : m_planes)
+			if (glm::dot(glm::vec3(p), centre) + p.w < -radius)
+				return false;
+		return true;
+	}
+
+	const glm::vec4& getPlane(unsigned int index) const { return m_planes[index]; }
+
+private:
+
+	// xyz is the inward facing normal, w the distance
+	glm::vec4	m_planes[6];
+};
+
+} // namespace aie
@@ -0,0 +1,243 @@
+#include "GeometryArena.h"
+#include "gl_core_4_4.h"
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+
+namespace aie {
+
+namespace {
+
+// smallest sizes the buffers start at, in their own units
+const unsigned int	MIN_VERTEX_CAPACITY = 1 << 16;
+const unsigned int	MIN_INDEX_CAPACITY = 1 << 17;
+const unsigned int	MIN_RECORD_CAPACITY = 1 << 8;
+
+// chunk record attributes
+const unsigned int	POSITION_OFFSET_ATTRIBUTE = 4;
+const unsigned int	POSITION_SCALE_ATTRIBUTE = 5;
+
+} // namespace
+
+GeometryArena::GeometryArena(unsigned int vertexSize, std::function<void()> setAttributes)
+	: m_vertexSize(vertexSize),
+	m_setAttributes(std::move(setAttributes)),
+	m_vao(0),
+	m_indirectBuffer(0),
+	m_recordDivisor(1),
+	m_allocationCount(0) {
+
+	m_vertices.handle = 0;
+	m_vertices.unitSize = vertexSize;
+	m_vertices.capacity = 0;
+
+	m_indices.handle = 0;
+	m_indices.unitSize = sizeof(unsigned int);
+	m_indices.capacity = 0;
+
+	m_records.handle = 0;
+	m_records.unitSize = sizeof(ChunkRecord);
+	m_records.capacity = 0;
+}
+
+GeometryArena::Allocation GeometryArena::allocate(const void* vertices, unsigned int vertexCount,
+												  const void* indices, unsigned int indexCount, unsigned int indexSize,
+												  const ChunkRecord& record) {
+
+	if (m_vao == 0)
+		create();
+
+	unsigned int indexUnits = (indexCount * indexSize + m_indices.unitSize - 1) / m_indices.unitSize;
+
+	// find room for each part, growing any buffer that is too full
+	unsigned int vertexOffset = 0;
+	unsigned int indexOffset = 0;
+	unsigned int recordOffset = 0;
+	bool grown = false;
+	if (allocateRange(m_vertices, vertexCount, vertexOffset) == false) {
+		grow(m_vertices, vertexCount);
+		allocateRange(m_vertices, vertexCount, vertexOffset);
+		grown = true;
+	}
+	if (allocateRange(m_indices, indexUnits, indexOffset) == false) {
+		grow(m_indices, indexUnits);
+		allocateRange(m_indices, indexUnits, indexOffset);
+		grown = true;
+	}
+	if (allocateRange(m_records, 1, recordOffset) == false) {
+		grow(m_records, 1);
+		allocateRange(m_records, 1, recordOffset);
+		grown = true;
+	}
+
+	// point the vertex array at the new buffers
+	if (grown) {
+		glBindVertexArray(m_vao);
+		glBindVertexBuffer(0, m_vertices.handle, 0, m_vertexSize);
+		glBindVertexBuffer(1, m_records.handle, 0, sizeof(ChunkRecord));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices.handle);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	// copy the chunk in
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertices.handle);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)vertexOffset * m_vertexSize, (GLsizeiptr)vertexCount * m_vertexSize, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_indices.handle);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)indexOffset * m_indices.unitSize, (GLsizeiptr)indexCount * indexSize, indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_records.handle);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)recordOffset * sizeof(ChunkRecord), sizeof(ChunkRecord), &record);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	Allocation allocation;
+	allocation.baseVertex = (int)vertexOffset;
+	allocation.vertexCount = vertexCount;
+	allocation.firstIndex = indexOffset * m_indices.unitSize / indexSize;
+	allocation.indexCount = indexCount;
+	allocation.indexSize = indexSize;
+	allocation.record = recordOffset;
+
+	++m_allocationCount;
+	return allocation;
+}
+
+void GeometryArena::free(const Allocation& allocation) {
+
+	if (m_allocationCount == 0)
+		return;
+
+	unsigned int indexUnits = (allocation.indexCount * allocation.indexSize + m_indices.unitSize - 1) / m_indices.unitSize;
+
+	freeRange(m_vertices, (unsigned int)allocation.baseVertex, allocation.vertexCount);
+	freeRange(m_indices, allocation.firstIndex * allocation.indexSize / m_indices.unitSize, indexUnits);
+	freeRange(m_records, allocation.record, 1);
+
+	if (--m_allocationCount == 0)
+		destroy();
+}
+
+void GeometryArena::bind(const DrawCommand* commands, size_t commandCount, unsigned int instanceCount /* = 1 */) {
+	glBindVertexArray(m_vao);
+
+	// the record is fetched at base instance + instance / divisor
+	if (m_recordDivisor != instanceCount) {
+		glVertexBindingDivisor(1, instanceCount);
+		m_recordDivisor = instanceCount;
+	}
+
+	// orphaned each time so earlier draws can still be reading the old commands
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCount * sizeof(DrawCommand), commands, GL_STREAM_DRAW);
+}
+
+bool GeometryArena::allocateRange(Buffer& buffer, unsigned int size, unsigned int& offset) {
+
+	offset = 0;
+	if (size == 0)
+		return true;
+
+	for (auto range = buffer.freeRanges.begin(); range != buffer.freeRanges.end(); ++range) {
+		if (range->second < size)
+			continue;
+
+		offset = range->first;
+		unsigned int remaining = range->second - size;
+		buffer.freeRanges.erase(range);
+		if (remaining > 0)
+			buffer.freeRanges[offset + size] = remaining;
+		return true;
+	}
+
+	return false;
+}
+
+void GeometryArena::freeRange(Buffer& buffer, unsigned int offset, unsigned int size) {
+
+	if (size == 0)
+		return;
+
+	auto range = buffer.freeRanges.insert(std::make_pair(offset, size)).first;
+
+	// merge with the range after
+	auto next = std::next(range);
+	if (next != buffer.freeRanges.end() &&
+		range->first + range->second == next->first) {
+		range->second += next->second;
+		buffer.freeRanges.erase(next);
+	}
+
+	// and the range before
+	if (range != buffer.freeRanges.begin()) {
+		auto previous = std::prev(range);
+		if (previous->first + previous->second == range->first) {
+			previous->second += range->second;
+			buffer.freeRanges.erase(range);
+		}
+	}
+}
+
+void GeometryArena::grow(Buffer& buffer, unsigned int size) {
+
+	unsigned int minimum = &buffer == &m_vertices ? MIN_VERTEX_CAPACITY :
+						   &buffer == &m_indices ? MIN_INDEX_CAPACITY : MIN_RECORD_CAPACITY;
+	unsigned int capacity = std::max(std::max(buffer.capacity * 2, buffer.capacity + size), minimum);
+
+	unsigned int handle = 0;
+	glGenBuffers(1, &handle);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, handle);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * buffer.unitSize, nullptr, GL_STATIC_DRAW);
+
+	if (buffer.handle != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer.handle);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)buffer.capacity * buffer.unitSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer.handle);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// the new space joins any free range at the end
+	freeRange(buffer, buffer.capacity, capacity - buffer.capacity);
+
+	buffer.handle = handle;
+	buffer.capacity = capacity;
+}
+
+void GeometryArena::create() {
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_indirectBuffer);
+
+	glBindVertexArray(m_vao);
+
+	m_setAttributes();
+
+	// one record per draw rather than per vertex
+	glEnableVertexAttribArray(POSITION_OFFSET_ATTRIBUTE);
+	glEnableVertexAttribArray(POSITION_SCALE_ATTRIBUTE);
+	glVertexAttribFormat(POSITION_OFFSET_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, offsetof(ChunkRecord, positionOffset));
+	glVertexAttribFormat(POSITION_SCALE_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, offsetof(ChunkRecord, positionScale));
+	glVertexAttribBinding(POSITION_OFFSET_ATTRIBUTE, 1);
+	glVertexAttribBinding(POSITION_SCALE_ATTRIBUTE, 1);
+	glVertexBindingDivisor(1, 1);
+	m_recordDivisor = 1;
+
+	glBindVertexArray(0);
+}
+
+void GeometryArena::destroy() {
+
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteBuffers(1, &m_indirectBuffer);
+	m_vao = 0;
+	m_indirectBuffer = 0;
+
+	for (Buffer* buffer : { &m_vertices, &m_indices, &m_records }) {
+		glDeleteBuffers(1, &buffer->handle);
+		buffer->handle = 0;
+		buffer->capacity = 0;
+		buffer->freeRanges.clear();
+	}
+}
+
+} // namespace aie
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+
+namespace aie {
+
+// one large vertex, index and chunk record buffer shared by many meshes, all
+// drawn through a single vertex array so switching between chunks needs no
+// binds, only a different base vertex, first index and base instance
+// everything here has to happen on the thread that owns the opengl context
+class GeometryArena {
+public:
+
+	// setAttributes is called with the arena's vertex array bound and describes
+	// the vertex attributes using glVertexAttribFormat and vertex buffer binding 0
+	// the chunk records are bound to attributes 4 and 5 through binding 1
+	GeometryArena(unsigned int vertexSize, std::function<void()> setAttributes);
+
+	// the buffers are deleted as the last allocation is freed, so nothing is
+	// left for the destructor to do once the context has gone
+	~GeometryArena() {}
+
+	// read by the vertex shader once per draw, selected by the base instance
+	struct ChunkRecord {
+		float	positionOffset[3];	// location 4
+		float	positionScale[3];	// location 5
+	};
+
+	// where a chunk's geometry lives in the arena
+	struct Allocation {
+		int				baseVertex;
+		unsigned int	vertexCount;
+		unsigned int	firstIndex;		// in units of the chunk's index size
+		unsigned int	indexCount;
+		unsigned int	indexSize;
+		unsigned int	record;			// base instance for draws of the chunk
+	};
+
+	// matches the layout glMultiDrawElementsIndirect reads
+	struct DrawCommand {
+		unsigned int	count;
+		unsigned int	instanceCount;
+		unsigned int	firstIndex;
+		int				baseVertex;
+		unsigned int	baseInstance;
+	};
+
+	// copies a chunk in, growing the buffers when it doesn't fit
+	// indices are unsigned shorts or ints depending on indexSize
+	Allocation allocate(const void* vertices, unsigned int vertexCount,
+						const void* indices, unsigned int indexCount, unsigned int indexSize,
+						const ChunkRecord& record);
+	void free(const Allocation& allocation);
+
+	// binds the vertex array, and the indirect buffer holding commands ready
+	// for glMultiDrawElementsIndirect, offsets start from 0
+	// commands drawing more than one instance all need the same instanceCount,
+	// so each instance still reads its chunk's record
+	void bind(const DrawCommand* commands, size_t commandCount, unsigned int instanceCount = 1);
+
+	unsigned int getVertexCapacity() const { return m_vertices.capacity; }
+	unsigned int getIndexCapacity() const { return m_indices.capacity * sizeof(unsigned int); }
+
+private:
+
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator = (const GeometryArena&) = delete;
+
+	// a buffer sub-allocated in units of unitSize bytes, first fit from a free
+	// list that merges neighbouring ranges back together
+	struct Buffer {
+		unsigned int							handle;
+		unsigned int							unitSize;
+		unsigned int							capacity;
+		std::map<unsigned int, unsigned int>	freeRanges;	// offset to size
+	};
+
+	bool allocateRange(Buffer& buffer, unsigned int size, unsigned int& offset);
+	void freeRange(Buffer& buffer, unsigned int offset, unsigned int size);
+
+	// copies in to a bigger buffer with room for at least size more units
+	void grow(Buffer& buffer, unsigned int size);
+
+	void create();
+	void destroy();
+
+	unsigned int			m_vertexSize;
+	std::function<void()>	m_setAttributes;
+
+	unsigned int			m_vao;
+	unsigned int			m_indirectBuffer;
+	unsigned int			m_recordDivisor;
+	Buffer					m_vertices;
+	Buffer					m_indices;	// in 4 byte units so every chunk is aligned for either index size
+	Buffer					m_records;
+
+	unsigned int			m_allocationCount;
+};
+
+} // namespace aie
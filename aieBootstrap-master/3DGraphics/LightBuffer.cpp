@@ -0,0 +1,92 @@
+#include "LightBuffer.h"
+#include "LightClusters.h"
+#include "gl_core_4_4.h"
+#include <cstring>
+
+namespace aie {
+
+namespace {
+
+// the light count and how to find a fragment's froxel lead the buffer, padded
+// out to where the std430 array starts
+struct LightHeader {
+	int				lightCount;
+	int				clustered;
+	float			minAttenuation;
+	int				padding;
+	unsigned int	clusterGrid[4];		// tiles x, tiles y, slices
+	float			clusterScale[4];	// tile scale x and y, slice scale and bias
+};
+
+// replaces a buffer's storage with a copy of size bytes of data
+void uploadStorage(unsigned int buffer, const void* data, size_t size) {
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)size, data, GL_STREAM_DRAW);
+}
+
+} // namespace
+
+LightBuffer::~LightBuffer() {
+	glDeleteBuffers(1, &m_buffer);
+	glDeleteBuffers(1, &m_clusterBuffer);
+	glDeleteBuffers(1, &m_indexBuffer);
+}
+
+void LightBuffer::update(const Light* lights, size_t lightCount, const LightClusters* clusters /* = nullptr */) {
+
+	if (m_buffer == 0) {
+		glGenBuffers(1, &m_buffer);
+		glGenBuffers(1, &m_clusterBuffer);
+		glGenBuffers(1, &m_indexBuffer);
+	}
+
+	GLsizeiptr size = (GLsizeiptr)(sizeof(LightHeader) + lightCount * sizeof(Light));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+	auto data = (unsigned char*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size,
+												 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (data != nullptr) {
+		LightHeader header = {};
+		header.lightCount = (int)lightCount;
+		if (clusters != nullptr) {
+			header.clustered = 1;
+			header.minAttenuation = clusters->getMinAttenuation();
+			header.clusterGrid[0] = clusters->getTileCountX();
+			header.clusterGrid[1] = clusters->getTileCountY();
+			header.clusterGrid[2] = clusters->getSliceCount();
+			header.clusterScale[0] = clusters->getTileScale().x;
+			header.clusterScale[1] = clusters->getTileScale().y;
+			header.clusterScale[2] = clusters->getSliceScale();
+			header.clusterScale[3] = clusters->getSliceBias();
+		}
+		memcpy(data, &header, sizeof(LightHeader));
+		if (lightCount > 0)
+			memcpy(data + sizeof(LightHeader), lights, lightCount * sizeof(Light));
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	}
+
+	// the lists are left as they were when unclustered, as the shader won't read them
+	if (clusters != nullptr) {
+		auto& ranges = clusters->getClusterRanges();
+		auto& indices = clusters->getLightIndices();
+		uploadStorage(m_clusterBuffer, ranges.data(), ranges.size() * sizeof(LightClusters::ClusterRange));
+
+		// an empty buffer can't be bound, so keep at least one index
+		unsigned int noLight = 0;
+		if (indices.empty())
+			uploadStorage(m_indexBuffer, &noLight, sizeof(noLight));
+		else
+			uploadStorage(m_indexBuffer, indices.data(), indices.size() * sizeof(unsigned int));
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightBuffer::bind() const {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, m_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, m_clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, m_indexBuffer);
+}
+
+} // namespace aie
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+
+namespace aie {
+
+class LightClusters;
+
+// matches the std430 Light struct in Phong.frag
+struct Light {
+
+	Light() : position(0), Ia(0), attenuation(0), Id(0), padding0(0), Is(0), padding1(0) {}
+
+	glm::vec4	position;		// w is 0 for a directional light, whose position is its direction
+	glm::vec3	Ia;
+	float		attenuation;
+	glm::vec3	Id;
+	float		padding0;
+	glm::vec3	Is;
+	float		padding1;
+};
+
+// every light in a scene packed in to one shader storage buffer, read by the
+// Lights block of Phong.frag, so however many lights there are is a single
+// upload and bind rather than uniforms set per light
+// everything here has to happen on the thread that owns the opengl context
+class LightBuffer {
+public:
+
+	LightBuffer() : m_buffer(0), m_clusterBuffer(0), m_indexBuffer(0) {}
+	~LightBuffer();
+
+	// shader storage binding points of the Lights, LightClusterRanges and
+	// LightClusterIndices blocks
+	static const unsigned int BINDING = 1;
+	static const unsigned int CLUSTER_BINDING = 2;
+	static const unsigned int LIGHT_INDEX_BINDING = 3;
+
+	// copies the lights in, once a frame after they have moved
+	// the buffers are orphaned each time so earlier draws can still be reading them
+	// with clusters built from the same lights each fragment only shades the
+	// lights listed for its froxel, otherwise it shades every light
+	void update(const Light* lights, size_t lightCount, const LightClusters* clusters = nullptr);
+
+	// binds the buffers to their binding points
+	void bind() const;
+
+	unsigned int getHandle() const { return m_buffer; }
+
+private:
+
+	LightBuffer(const LightBuffer&) = delete;
+	LightBuffer& operator = (const LightBuffer&) = delete;
+
+	unsigned int	m_buffer;
+
+	// each froxel's offset and count, then the light indices they point in to
+	unsigned int	m_clusterBuffer;
+	unsigned int	m_indexBuffer;
+};
+
+} // namespace aie
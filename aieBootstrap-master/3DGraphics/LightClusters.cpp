@@ -0,0 +1,273 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace aie {
+
+namespace {
+
+// lights whose bounds are found by each job
+const unsigned int	LIGHTS_PER_JOB = 256;
+
+} // namespace
+
+LightClusters::LightClusters(unsigned int tilesX /* = 16 */, unsigned int tilesY /* = 9 */, unsigned int slices /* = 24 */,
+							 float minAttenuation /* = 1.0f / 256 */)
+	: m_tilesX(std::max(tilesX, 1u)),
+	m_tilesY(std::max(tilesY, 1u)),
+	m_slices(std::max(slices, 1u)),
+	m_minAttenuation(minAttenuation),
+	m_near(1),
+	m_far(2),
+	m_tileScale(0),
+	m_sliceScale(0),
+	m_sliceBias(0),
+	m_projection(0),
+	m_buildMilliseconds(0) {
+}
+
+float LightClusters::getLightRadius(const Light& light, float minAttenuation) {
+
+	// attenuation is 1 / (1 + a * d^2)
+	if (light.position.w == 0 ||
+		light.attenuation <= 0 ||
+		minAttenuation <= 0)
+		return std::numeric_limits<float>::infinity();
+
+	return std::sqrt((1.0f / minAttenuation - 1.0f) / light.attenuation);
+}
+
+void LightClusters::build(const Light* lights, size_t lightCount,
+						  const glm::mat4& view, const glm::mat4& projection, const glm::vec2& viewportSize) {
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (projection != m_projection ||
+		m_clusterMin.empty())
+		buildClusterBounds(projection);
+
+	m_tileScale = glm::vec2(m_tilesX / std::max(viewportSize.x, 1.0f), m_tilesY / std::max(viewportSize.y, 1.0f));
+
+	// an orthographic projection has no depth to slice by, so every light
+	// is treated as reaching everywhere
+	bool perspective = projection[2][3] != 0;
+
+	// find the froxels covered by the bounds of each light
+	m_lightBounds.resize(lightCount);
+	ThreadPool& pool = ThreadPool::get();
+	unsigned int boundsJobs = (unsigned int)((lightCount + LIGHTS_PER_JOB - 1) / LIGHTS_PER_JOB);
+	pool.parallelFor(boundsJobs, [&](unsigned int job) {
+		size_t first = (size_t)job * LIGHTS_PER_JOB;
+		size_t last = std::min(first + LIGHTS_PER_JOB, lightCount);
+		for (size_t i = first; i < last; ++i) {
+			LightBounds& bounds = m_lightBounds[i];
+			bounds.radius = getLightRadius(lights[i], m_minAttenuation);
+			bounds.global = perspective == false || std::isinf(bounds.radius);
+			bounds.visible = true;
+			if (bounds.global)
+				continue;
+
+			bounds.centre = glm::vec3(view * glm::vec4(glm::vec3(lights[i].position), 1));
+			float depth = -bounds.centre.z;
+			float nearest = std::max(depth - bounds.radius, m_near);
+			float furthest = std::min(depth + bounds.radius, m_far);
+			if (nearest > furthest) {
+				bounds.visible = false;
+				continue;
+			}
+
+			// the screen extent of the sphere's box, whose corners are the extremes
+			// as the box is kept in front of the camera
+			glm::vec2 ndcMin(std::numeric_limits<float>::max());
+			glm::vec2 ndcMax(-std::numeric_limits<float>::max());
+			for (unsigned int corner = 0; corner < 8; ++corner) {
+				glm::vec4 position(bounds.centre.x + ((corner & 1) ? bounds.radius : -bounds.radius),
+								   bounds.centre.y + ((corner & 2) ? bounds.radius : -bounds.radius),
+								   (corner & 4) ? -furthest : -nearest, 1);
+				glm::vec4 clip = projection * position;
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+
+			if (ndcMax.x < -1 || ndcMin.x > 1 ||
+				ndcMax.y < -1 || ndcMin.y > 1) {
+				bounds.visible = false;
+				continue;
+			}
+
+			glm::vec2 tileCount((float)m_tilesX, (float)m_tilesY);
+			glm::vec2 firstTile = glm::clamp(glm::floor((ndcMin + 1.0f) * 0.5f * tileCount), glm::vec2(0), tileCount - 1.0f);
+			glm::vec2 lastTile = glm::clamp(glm::floor((ndcMax + 1.0f) * 0.5f * tileCount), glm::vec2(0), tileCount - 1.0f);
+			bounds.firstTile[0] = (unsigned int)firstTile.x;
+			bounds.firstTile[1] = (unsigned int)firstTile.y;
+			bounds.lastTile[0] = (unsigned int)lastTile.x;
+			bounds.lastTile[1] = (unsigned int)lastTile.y;
+			bounds.firstSlice = depthSlice(nearest);
+			bounds.lastSlice = depthSlice(furthest);
+		}
+	});
+
+	// each slice job tests the lights against its own froxels, so no two jobs
+	// write to the same lists
+	unsigned int tilesPerSlice = m_tilesX * m_tilesY;
+	m_sliceEntries.resize(m_slices);
+	m_sliceIndices.resize(m_slices);
+	m_ranges.resize(getClusterCount());
+	pool.parallelFor(m_slices, [&](unsigned int slice) {
+		auto& entries = m_sliceEntries[slice];
+		entries.clear();
+
+		for (unsigned int i = 0; i < (unsigned int)lightCount; ++i) {
+			const LightBounds& bounds = m_lightBounds[i];
+			if (bounds.visible == false)
+				continue;
+
+			if (bounds.global) {
+				for (unsigned int tile = 0; tile < tilesPerSlice; ++tile)
+					entries.push_back(std::make_pair(tile, i));
+				continue;
+			}
+
+			if (slice < bounds.firstSlice ||
+				slice > bounds.lastSlice)
+				continue;
+
+			// only the froxels whose box the sphere touches
+			for (unsigned int y = bounds.firstTile[1]; y <= bounds.lastTile[1]; ++y) {
+				for (unsigned int x = bounds.firstTile[0]; x <= bounds.lastTile[0]; ++x) {
+					unsigned int cluster = getCluster(x, y, slice);
+					glm::vec3 closest = glm::clamp(bounds.centre, m_clusterMin[cluster], m_clusterMax[cluster]);
+					glm::vec3 offset = closest - bounds.centre;
+					if (glm::dot(offset, offset) <= bounds.radius * bounds.radius)
+						entries.push_back(std::make_pair(x + m_tilesX * y, i));
+				}
+			}
+		}
+
+		// counting sort by froxel, offsets relative to the slice for now
+		ClusterRange* ranges = m_ranges.data() + (size_t)slice * tilesPerSlice;
+		for (unsigned int tile = 0; tile < tilesPerSlice; ++tile)
+			ranges[tile].count = 0;
+		for (auto& entry : entries)
+			++ranges[entry.first].count;
+
+		unsigned int offset = 0;
+		for (unsigned int tile = 0; tile < tilesPerSlice; ++tile) {
+			ranges[tile].offset = offset;
+			offset += ranges[tile].count;
+		}
+
+		auto& indices = m_sliceIndices[slice];
+		indices.resize(entries.size());
+		for (unsigned int tile = 0; tile < tilesPerSlice; ++tile)
+			ranges[tile].count = 0;
+		for (auto& entry : entries) {
+			ClusterRange& range = ranges[entry.first];
+			indices[range.offset + range.count++] = entry.second;
+		}
+	});
+
+	// join the slices' lists together
+	size_t indexCount = 0;
+	for (auto& indices : m_sliceIndices)
+		indexCount += indices.size();
+	m_lightIndices.resize(indexCount);
+
+	unsigned int sliceOffset = 0;
+	for (unsigned int slice = 0; slice < m_slices; ++slice) {
+		auto& indices = m_sliceIndices[slice];
+		std::copy(indices.begin(), indices.end(), m_lightIndices.begin() + sliceOffset);
+
+		ClusterRange* ranges = m_ranges.data() + (size_t)slice * tilesPerSlice;
+		for (unsigned int tile = 0; tile < tilesPerSlice; ++tile)
+			ranges[tile].offset += sliceOffset;
+		sliceOffset += (unsigned int)indices.size();
+	}
+
+	m_buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int LightClusters::findCluster(const glm::vec3& viewPosition) const {
+
+	float depth = -viewPosition.z;
+	if (depth < m_near ||
+		depth > m_far)
+		return -1;
+
+	glm::vec4 clip = m_projection * glm::vec4(viewPosition, 1);
+	glm::vec2 ndc = glm::vec2(clip) / clip.w;
+	if (ndc.x < -1 || ndc.x > 1 ||
+		ndc.y < -1 || ndc.y > 1)
+		return -1;
+
+	unsigned int x = std::min((unsigned int)((ndc.x + 1) * 0.5f * m_tilesX), m_tilesX - 1);
+	unsigned int y = std::min((unsigned int)((ndc.y + 1) * 0.5f * m_tilesY), m_tilesY - 1);
+	return (int)getCluster(x, y, depthSlice(depth));
+}
+
+void LightClusters::buildClusterBounds(const glm::mat4& projection) {
+
+	m_projection = projection;
+
+	// near and far planes from the matrix, see glm::perspective
+	m_near = 1;
+	m_far = 2;
+	if (projection[2][3] != 0) {
+		m_near = projection[3][2] / (projection[2][2] - 1);
+		m_far = projection[3][2] / (projection[2][2] + 1);
+	}
+
+	float range = std::log(m_far / m_near);
+	m_sliceScale = m_slices / range;
+	m_sliceBias = -(float)m_slices * std::log(m_near) / range;
+
+	// the direction through each tile corner, scaled to a depth of 1
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	std::vector<glm::vec3> corners((m_tilesX + 1) * (m_tilesY + 1));
+	for (unsigned int y = 0; y <= m_tilesY; ++y) {
+		for (unsigned int x = 0; x <= m_tilesX; ++x) {
+			glm::vec4 ndc(-1.0f + 2.0f * x / m_tilesX, -1.0f + 2.0f * y / m_tilesY, -1, 1);
+			glm::vec4 position = inverseProjection * ndc;
+			corners[x + (m_tilesX + 1) * y] = glm::vec3(position) / -position.z;
+		}
+	}
+
+	m_clusterMin.resize(getClusterCount());
+	m_clusterMax.resize(getClusterCount());
+	for (unsigned int slice = 0; slice < m_slices; ++slice) {
+		float depths[2] = { sliceDepth((float)slice), sliceDepth((float)slice + 1) };
+
+		for (unsigned int y = 0; y < m_tilesY; ++y) {
+			for (unsigned int x = 0; x < m_tilesX; ++x) {
+				glm::vec3 clusterMin(std::numeric_limits<float>::max());
+				glm::vec3 clusterMax(-std::numeric_limits<float>::max());
+				for (unsigned int corner = 0; corner < 4; ++corner) {
+					const glm::vec3& direction = corners[(x + (corner & 1)) + (m_tilesX + 1) * (y + (corner >> 1))];
+					for (float depth : depths) {
+						clusterMin = glm::min(clusterMin, direction * depth);
+						clusterMax = glm::max(clusterMax, direction * depth);
+					}
+				}
+
+				unsigned int cluster = getCluster(x, y, slice);
+				m_clusterMin[cluster] = clusterMin;
+				m_clusterMax[cluster] = clusterMax;
+			}
+		}
+	}
+}
+
+float LightClusters::sliceDepth(float slice) const {
+	return m_near * std::pow(m_far / m_near, slice / m_slices);
+}
+
+unsigned int LightClusters::depthSlice(float depth) const {
+	float slice = std::floor(std::log(depth) * m_sliceScale + m_sliceBias);
+	return (unsigned int)std::min(std::max(slice, 0.0f), (float)(m_slices - 1));
+}
+
+} // namespace aie
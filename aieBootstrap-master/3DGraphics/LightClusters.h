@@ -0,0 +1,114 @@
+#pragma once
+
+#include "LightBuffer.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace aie {
+
+// splits a perspective view in to froxels, tiles across the screen by slices
+// that grow exponentially deeper, and lists which lights reach each one so a
+// fragment only shades the lights of its own froxel
+// a point light reaches as far as its attenuation stays above minAttenuation,
+// directional lights and point lights without attenuation reach every froxel
+// building only touches memory, so it can run without an opengl context, the
+// lists are uploaded by LightBuffer::update()
+class LightClusters {
+public:
+
+	LightClusters(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24,
+				  float minAttenuation = 1.0f / 256);
+	~LightClusters() {}
+
+	// where a froxel's lights are in getLightIndices()
+	struct ClusterRange {
+		unsigned int	offset;
+		unsigned int	count;
+	};
+
+	// bins the lights on the shared ThreadPool, one job per slice
+	// projection has to be perspective, viewportSize is in pixels
+	void build(const Light* lights, size_t lightCount,
+			   const glm::mat4& view, const glm::mat4& projection, const glm::vec2& viewportSize);
+
+	// distance at which the light's attenuation drops to minAttenuation, or
+	// infinity for lights that never do
+	static float getLightRadius(const Light& light, float minAttenuation);
+
+	unsigned int getTileCountX() const { return m_tilesX; }
+	unsigned int getTileCountY() const { return m_tilesY; }
+	unsigned int getSliceCount() const { return m_slices; }
+	unsigned int getClusterCount() const { return m_tilesX * m_tilesY * m_slices; }
+	float getMinAttenuation() const { return m_minAttenuation; }
+
+	// froxels are ordered x fastest, then y, then slice
+	unsigned int getCluster(unsigned int x, unsigned int y, unsigned int slice) const {
+		return x + m_tilesX * (y + m_tilesY * slice);
+	}
+
+	// the froxel holding a view space point, or -1 if it is outside the view
+	int findCluster(const glm::vec3& viewPosition) const;
+
+	const std::vector<ClusterRange>& getClusterRanges() const { return m_ranges; }
+	const std::vector<unsigned int>& getLightIndices() const { return m_lightIndices; }
+
+	// turn a pixel position in to a tile and a view depth in to a slice with
+	// tile = pixel * tileScale and slice = log(depth) * sliceScale + sliceBias
+	const glm::vec2& getTileScale() const { return m_tileScale; }
+	float getSliceScale() const { return m_sliceScale; }
+	float getSliceBias() const { return m_sliceBias; }
+
+	// time taken by the last build
+	float getBuildMilliseconds() const { return m_buildMilliseconds; }
+
+private:
+
+	// a light's view space sphere and the froxels its bounds cover
+	struct LightBounds {
+		glm::vec3		centre;
+		float			radius;
+		bool			visible;
+		bool			global;
+		unsigned int	firstTile[2];
+		unsigned int	lastTile[2];
+		unsigned int	firstSlice;
+		unsigned int	lastSlice;
+	};
+
+	// rebuilds the view space bounds of every froxel for a new projection
+	void buildClusterBounds(const glm::mat4& projection);
+
+	float sliceDepth(float slice) const;
+	unsigned int depthSlice(float depth) const;
+
+	unsigned int	m_tilesX;
+	unsigned int	m_tilesY;
+	unsigned int	m_slices;
+	float			m_minAttenuation;
+
+	float			m_near;
+	float			m_far;
+	glm::vec2		m_tileScale;
+	float			m_sliceScale;
+	float			m_sliceBias;
+
+	// view space boxes, only rebuilt when the projection changes
+	glm::mat4				m_projection;
+	std::vector<glm::vec3>	m_clusterMin;
+	std::vector<glm::vec3>	m_clusterMax;
+
+	std::vector<LightBounds>	m_lightBounds;
+
+	// each slice job's froxel and light pairs, then its lights in froxel order
+	std::vector<std::vector<std::pair<unsigned int, unsigned int>>>	m_sliceEntries;
+	std::vector<std::vector<unsigned int>>								m_sliceIndices;
+
+	std::vector<ClusterRange>	m_ranges;
+	std::vector<unsigned int>	m_lightIndices;
+
+	float			m_buildMilliseconds;
+};
+
+} // namespace aie
@@ -0,0 +1,122 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace aie {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	: m_data(nullptr),
+	m_size(0),
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr) {
+}
+
+bool MappedFile::open(const char* filename) {
+
+	close();
+
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+						 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(m_file, &size) == FALSE ||
+		size.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr) {
+		close();
+		return false;
+	}
+
+	m_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+	: m_data(nullptr),
+	m_size(0),
+	m_file(-1) {
+}
+
+bool MappedFile::open(const char* filename) {
+
+	close();
+
+	m_file = ::open(filename, O_RDONLY);
+	if (m_file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0 ||
+		info.st_size == 0) {
+		close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED) {
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)data;
+	m_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (m_data != nullptr)
+		munmap((void*)m_data, m_size);
+	if (m_file >= 0)
+		::close(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_file = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+} // namespace aie
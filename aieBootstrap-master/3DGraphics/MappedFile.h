@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+namespace aie {
+
+// a read-only view of an entire file mapped in to memory
+class MappedFile {
+public:
+
+	MappedFile();
+	~MappedFile();
+
+	// will fail if the file doesn't exist or is empty
+	bool open(const char* filename);
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+
+	const unsigned char* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+private:
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+
+	const unsigned char*	m_data;
+	size_t					m_size;
+
+#ifdef _WIN32
+	void*	m_file;
+	void*	m_mapping;
+#else
+	int		m_file;
+#endif
+};
+
+} // namespace aie
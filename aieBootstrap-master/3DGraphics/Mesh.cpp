@@ -16,8 +16,19 @@ Mesh::Mesh(const unsigned int maxTris, const unsigned int maxlines) :
 	m_maxTris = maxTris;
 	// sets the tri vertices to be 3 times the amount of maximum tris (won't likely fill the space because some vertices will often overlap)
 	m_triVertices = new Vertex[m_maxTris * 3];
+	// uses 16 bit indices when every possible tri vertex can be reached with them, halving the index buffer
+	if (m_maxTris * 3 <= 0x10000)
+	{
+		m_triIndexSize = sizeof(unsigned short);
+		m_triIndexType = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		m_triIndexSize = sizeof(unsigned int);
+		m_triIndexType = GL_UNSIGNED_INT;
+	}
 	// sets the tri indices to be 3 time the amount of maximum tris
-	m_triIndices = new unsigned int[m_maxTris * 3];
+	m_triIndices = new unsigned char[m_maxTris * 3 * m_triIndexSize];
 	m_maxLines = maxlines;
 	// sets the line vertices to be 2 times the amount of maximum lines
 	m_lineVertices = new Vertex[m_maxLines * 2];
@@ -33,7 +44,7 @@ Mesh::Mesh(const unsigned int maxTris, const unsigned int maxlines) :
 	// generate tri index buffer, bind it and fill it
 	glGenBuffers(1, &m_triIBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_triIBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_maxTris * 3 * sizeof(unsigned int), m_triIndices, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_maxTris * 3 * m_triIndexSize, m_triIndices, GL_DYNAMIC_DRAW);
 
 	// enable position, colour/normal and texture attributes of the shader for the vertex array
 	glEnableVertexAttribArray(0);
@@ -146,17 +157,17 @@ void Mesh::AddTri(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 &
 				// sets the flag of the vertex to existing
 				exists[0] = true;
 				// uses the index of the original vertex
-				m_triIndices[m_triIndexCount] = i;
+				SetTriIndex(m_triIndexCount, i);
 			}
 			if (glm::vec3(m_triVertices[i].position) == v1)
 			{
 				exists[1] = true;
-				m_triIndices[m_triIndexCount + 1] = i;
+				SetTriIndex(m_triIndexCount + 1, i);
 			}
 			if (glm::vec3(m_triVertices[i].position) == v2)
 			{
 				exists[2] = true;
-				m_triIndices[m_triIndexCount + 2] = i;
+				SetTriIndex(m_triIndexCount + 2, i);
 			}
 		}
 		// checks if the vertex has not been added to the array yet
@@ -173,7 +184,7 @@ void Mesh::AddTri(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 &
 			m_triVertices[m_triVertexCount].normal.w = colour.w;
 			// adds the new index to the array
 			// does not increment the count until the end because it's easier to keep track of the current index amount
-			m_triIndices[m_triIndexCount] = m_triVertexCount;
+			SetTriIndex(m_triIndexCount, m_triVertexCount);
 			m_triVertexCount++;
 		}
 		if (!exists[1])
@@ -186,7 +197,7 @@ void Mesh::AddTri(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 &
 			m_triVertices[m_triVertexCount].normal.y = colour.y;
 			m_triVertices[m_triVertexCount].normal.z = colour.z;
 			m_triVertices[m_triVertexCount].normal.w = colour.w;
-			m_triIndices[m_triIndexCount + 1] = m_triVertexCount;
+			SetTriIndex(m_triIndexCount + 1, m_triVertexCount);
 			m_triVertexCount++;
 		}
 		if (!exists[2])
@@ -199,7 +210,7 @@ void Mesh::AddTri(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 &
 			m_triVertices[m_triVertexCount].normal.y = colour.y;
 			m_triVertices[m_triVertexCount].normal.z = colour.z;
 			m_triVertices[m_triVertexCount].normal.w = colour.w;
-			m_triIndices[m_triIndexCount + 2] = m_triVertexCount;
+			SetTriIndex(m_triIndexCount + 2, m_triVertexCount);
 			m_triVertexCount++;
 		}
 
@@ -588,12 +599,12 @@ void Mesh::Draw()
 		glBindVertexArray(m_triVAO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_triIBO);
 		// sets the index data
-		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_triIndexCount * sizeof(unsigned int), m_triIndices);		
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_triIndexCount * m_triIndexSize, m_triIndices);		
 		glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
 		// sets the vertex data
 		glBufferSubData(GL_ARRAY_BUFFER, 0, m_triVertexCount * sizeof(Vertex), m_triVertices);
 		// draws the vertices
-		glDrawElements(GL_TRIANGLES, m_triIndexCount, GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, m_triIndexCount, m_triIndexType, 0);
 	}
 	// checks if there are any lines to draw
 	if ((m_lineVertexCount * 2) > 0)
@@ -606,4 +617,20 @@ void Mesh::Draw()
 		// draws the vertices
 		glDrawArrays(GL_LINES, 0, m_lineVertexCount);
 	}
+}
+
+/*
+	\fn void SetTriIndex(const unsigned int position, const unsigned int index)
+	\brief Stores a tri index at the size the index buffer uses.
+*/
+void Mesh::SetTriIndex(const unsigned int position, const unsigned int index)
+{
+	if (m_triIndexSize == sizeof(unsigned short))
+	{
+		((unsigned short*)m_triIndices)[position] = (unsigned short)index;
+	}
+	else
+	{
+		((unsigned int*)m_triIndices)[position] = index;
+	}
 }
\ No newline at end of file
@@ -116,6 +116,14 @@ public:
 	virtual void Draw();
 
 protected:
+	/*
+		\fn void SetTriIndex(const unsigned int position, const unsigned int index)
+		\brief Stores a tri index at the size the index buffer uses.
+		\param position The position in the index array.
+		\param index The index of the vertex.
+	*/
+	void SetTriIndex(const unsigned int position, const unsigned int index);
+
 	/*
 		\struct Vertex
 		\brief A vertex of a tri or line.
@@ -140,10 +148,14 @@ protected:
 		Collection of vertices for tris.
 		\var unsigned int m_triVertexCount
 		The amount of tri vertices.
-		\var unsigned int* m_triIndices
-		Collection of indices for tris.
+		\var unsigned char* m_triIndices
+		Collection of indices for tris, stored as unsigned shorts or unsigned ints.
 		\var unsigned int m_triIndexCount
 		The amount of indices.
+		\var unsigned int m_triIndexSize
+		The size of each index, 2 bytes when every vertex can be reached with 16 bits.
+		\var unsigned int m_triIndexType
+		The OpenGL type of each index.
 		\var unsigned int m_triVAO
 		Vertex array for tris.
 		\var unsigned int m_triVBO
@@ -154,8 +166,10 @@ protected:
 	unsigned int m_maxTris;
 	Vertex* m_triVertices;
 	unsigned int m_triVertexCount;
-	unsigned int* m_triIndices;
+	unsigned char* m_triIndices;
 	unsigned int m_triIndexCount;
+	unsigned int m_triIndexSize;
+	unsigned int m_triIndexType;
 	unsigned int m_triVAO, m_triVBO, m_triIBO;
 
 	/*
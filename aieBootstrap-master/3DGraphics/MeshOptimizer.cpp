@@ -0,0 +1,737 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace aie {
+
+namespace {
+
+glm::vec3 readPosition(const float* positions, size_t positionStride, unsigned int v) {
+	const float* p = (const float*)((const char*)positions + v * positionStride);
+	return glm::vec3(p[0], p[1], p[2]);
+}
+
+// gives vertices that share a position the same id, so that vertices split
+// along uv or normal seams can be treated as one, returns the number of ids
+unsigned int buildPositionIDs(const float* positions, size_t positionStride, size_t vertexCount,
+							  std::vector<unsigned int>& positionIDs) {
+
+	std::vector<unsigned int> sortedVertices(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		sortedVertices[v] = (unsigned int)v;
+	std::sort(sortedVertices.begin(), sortedVertices.end(), [&](unsigned int a, unsigned int b) {
+		glm::vec3 pa = readPosition(positions, positionStride, a);
+		glm::vec3 pb = readPosition(positions, positionStride, b);
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		return pa.z < pb.z;
+	});
+
+	positionIDs.resize(vertexCount);
+	unsigned int positionCount = 0;
+	for (size_t i = 0; i < vertexCount; ++i) {
+		if (i > 0 &&
+			readPosition(positions, positionStride, sortedVertices[i]) != readPosition(positions, positionStride, sortedVertices[i - 1]))
+			++positionCount;
+		positionIDs[sortedVertices[i]] = positionCount;
+	}
+	return vertexCount > 0 ? positionCount + 1 : 0;
+}
+
+// sum of squared distances to a set of planes, each weighted by the area of
+// the triangle it came from
+struct Quadric {
+	double	a00, a11, a22, a01, a02, a12;
+	double	b0, b1, b2;
+	double	c;
+	double	weight;
+
+	void addPlane(const glm::vec3& normal, float distance, float area) {
+		double x = normal.x, y = normal.y, z = normal.z, d = distance;
+		a00 += area * x * x; a11 += area * y * y; a22 += area * z * z;
+		a01 += area * x * y; a02 += area * x * z; a12 += area * y * z;
+		b0 += area * x * d; b1 += area * y * d; b2 += area * z * d;
+		c += area * d * d;
+		weight += area;
+	}
+
+	void add(const Quadric& q) {
+		a00 += q.a00; a11 += q.a11; a22 += q.a22;
+		a01 += q.a01; a02 += q.a02; a12 += q.a12;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+		weight += q.weight;
+	}
+
+	double evaluate(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return a00 * x * x + a11 * y * y + a22 * z * z +
+			2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+			2 * (b0 * x + b1 * y + b2 * z) + c;
+	}
+};
+
+// triangles from first up to last in an index buffer
+struct IndexRange {
+	unsigned int	first, last;
+};
+
+// the order to draw ranges in so the ones facing out from the middle of the
+// mesh come first
+std::vector<size_t> overdrawOrder(const unsigned int* indices, const float* positions, size_t positionStride,
+								  const std::vector<IndexRange>& ranges) {
+
+	auto position = [&](unsigned int v) {
+		return (const float*)((const char*)positions + v * positionStride);
+	};
+
+	struct Cluster {
+		float			centroid[3];
+		float			normal[3];
+		float			area;
+		float			sortKey;
+	};
+
+	// area weighted centroid and normal of each cluster, and of the whole mesh
+	std::vector<Cluster> clusters(ranges.size());
+	float meshCentroid[3] = {};
+	float meshArea = 0;
+
+	for (size_t c = 0; c < ranges.size(); ++c) {
+		Cluster& cluster = clusters[c];
+		memset(cluster.centroid, 0, sizeof(cluster.centroid));
+		memset(cluster.normal, 0, sizeof(cluster.normal));
+		cluster.area = 0;
+
+		for (unsigned int i = ranges[c].first; i < ranges[c].last; i += 3) {
+			const float* p0 = position(indices[i + 0]);
+			const float* p1 = position(indices[i + 1]);
+			const float* p2 = position(indices[i + 2]);
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+						   e1[2] * e2[0] - e1[0] * e2[2],
+						   e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; ++k) {
+				cluster.centroid[k] += (p0[k] + p1[k] + p2[k]) * area;
+				cluster.normal[k] += n[k];
+			}
+			cluster.area += area;
+		}
+
+		for (int k = 0; k < 3; ++k)
+			meshCentroid[k] += cluster.centroid[k];
+		meshArea += cluster.area;
+	}
+
+	for (int k = 0; k < 3; ++k)
+		meshCentroid[k] = meshArea > 0 ? meshCentroid[k] / (meshArea * 3) : 0;
+
+	// how far a cluster faces out from the middle of the mesh
+	for (auto& cluster : clusters) {
+		float length = std::sqrt(cluster.normal[0] * cluster.normal[0] +
+								 cluster.normal[1] * cluster.normal[1] +
+								 cluster.normal[2] * cluster.normal[2]);
+		cluster.sortKey = 0;
+		if (cluster.area > 0 &&
+			length > 0) {
+			for (int k = 0; k < 3; ++k)
+				cluster.sortKey += (cluster.centroid[k] / (cluster.area * 3) - meshCentroid[k]) * cluster.normal[k] / length;
+		}
+	}
+
+	std::vector<size_t> order(ranges.size());
+	for (size_t c = 0; c < order.size(); ++c)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return clusters[a].sortKey > clusters[b].sortKey;
+	});
+	return order;
+}
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount,
+									size_t vertexCount, unsigned int cacheSize /* = 16 */) {
+
+	VertexCacheStats stats = {};
+	stats.triangleCount = indexCount / 3;
+	stats.vertexCount = vertexCount;
+
+	// a vertex is still cached if fewer than cacheSize misses have happened
+	// since it was added, 0 means it has never been added
+	std::vector<size_t> added(vertexCount, 0);
+	size_t time = 0;
+
+	for (size_t i = 0; i < stats.triangleCount * 3; ++i) {
+		unsigned int v = indices[i];
+		if (added[v] == 0 ||
+			time - added[v] >= cacheSize) {
+			added[v] = ++time;
+			++stats.transformedCount;
+		}
+	}
+
+	if (stats.triangleCount > 0)
+		stats.acmr = (float)stats.transformedCount / stats.triangleCount;
+	if (stats.vertexCount > 0)
+		stats.atvr = (float)stats.transformedCount / stats.vertexCount;
+	return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount,
+						 unsigned int cacheSize /* = 16 */, std::vector<unsigned int>* clusters /* = nullptr */) {
+
+	if (clusters != nullptr)
+		clusters->clear();
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// triangles that use each vertex, and how many of them are yet to be emitted
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		++liveTriangles[indices[i]];
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	// the time each vertex last entered the cache
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	unsigned int fan = indices[0];
+	size_t cursor = 0;
+	bool newCluster = true;
+
+	for (;;) {
+
+		if (newCluster &&
+			clusters != nullptr)
+			clusters->push_back((unsigned int)output.size());
+
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; ++a) {
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (unsigned int j = 0; j < 3; ++j) {
+				unsigned int v = indices[t * 3 + j];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = 1;
+		}
+
+		// fan next around the candidate that will still be cached once its own
+		// triangles are emitted, preferring the one that entered the cache first
+		int next = -1;
+		int bestPriority = -1;
+		for (auto v : candidates) {
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = (int)(time - cacheTime[v]);
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = (int)v;
+			}
+		}
+
+		// dead end, try recently used vertices and then the input order
+		newCluster = next < 0;
+		while (next < 0 &&
+			   deadEnds.empty() == false) {
+			unsigned int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0)
+				next = (int)v;
+		}
+		while (next < 0 &&
+			   cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0)
+				next = (int)cursor;
+			++cursor;
+		}
+
+		if (next < 0)
+			break;
+		fan = (unsigned int)next;
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+					  const float* positions, size_t positionStride,
+					  const std::vector<unsigned int>& clusters) {
+
+	size_t triangleCount = indexCount / 3;
+	if (clusters.size() < 2 ||
+		triangleCount == 0)
+		return;
+
+	std::vector<IndexRange> ranges(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		ranges[c].first = clusters[c];
+		ranges[c].last = c + 1 < clusters.size() ? clusters[c + 1] : (unsigned int)(triangleCount * 3);
+	}
+
+	std::vector<size_t> order = overdrawOrder(indices, positions, positionStride, ranges);
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (auto c : order)
+		output.insert(output.end(), indices + ranges[c].first, indices + ranges[c].last);
+
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+					  const float* positions, size_t positionStride,
+					  std::vector<MeshCluster>& clusters) {
+
+	if (clusters.size() < 2 ||
+		indexCount < 3)
+		return;
+
+	std::vector<IndexRange> ranges(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		ranges[c].first = clusters[c].firstIndex;
+		ranges[c].last = clusters[c].firstIndex + clusters[c].indexCount;
+	}
+
+	std::vector<size_t> order = overdrawOrder(indices, positions, positionStride, ranges);
+
+	// the clusters follow their triangles
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	std::vector<MeshCluster> sorted;
+	sorted.reserve(clusters.size());
+	for (auto c : order) {
+		sorted.push_back(clusters[c]);
+		sorted.back().firstIndex = (unsigned int)output.size();
+		output.insert(output.end(), indices + ranges[c].first, indices + ranges[c].last);
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+	clusters.swap(sorted);
+}
+
+void buildClusters(const unsigned int* indices, size_t indexCount,
+				   const float* positions, size_t positionStride,
+				   std::vector<MeshCluster>& clusters,
+				   unsigned int minTriangles /* = 64 */, unsigned int maxTriangles /* = 128 */) {
+
+	// triangles facing further than this from a cluster's average end it
+	// once it has minTriangles
+	const float CONE_COSINE = 0.7071f;
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	auto position = [&](unsigned int v) {
+		return readPosition(positions, positionStride, v);
+	};
+
+	auto normal = [&](size_t t) {
+		glm::vec3 p0 = position(indices[t * 3 + 0]);
+		glm::vec3 n = glm::cross(position(indices[t * 3 + 1]) - p0, position(indices[t * 3 + 2]) - p0);
+		float length = glm::length(n);
+		return length > 0 ? n / length : glm::vec3(0);
+	};
+
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> points;
+
+	// the cluster's triangles are those in [first, t)
+	size_t first = 0;
+	glm::vec3 normalSum(0);
+
+	auto close = [&](size_t last) {
+		MeshCluster cluster;
+		cluster.firstIndex = (unsigned int)(first * 3);
+		cluster.indexCount = (unsigned int)((last - first) * 3);
+
+		points.clear();
+		for (size_t i = first * 3; i < last * 3; ++i)
+			points.push_back(position(indices[i]));
+		cluster.bounds.fit(points);
+
+		// the cone can only cull when it is narrower than a hemisphere
+		// degenerate triangles are never drawn so don't widen it
+		float length = glm::length(normalSum);
+		cluster.coneAxis = length > 0 ? normalSum / length : glm::vec3(0, 0, 1);
+		float minimumDot = length > 0 ? 1.0f : 0.0f;
+		for (auto& n : normals)
+			if (n != glm::vec3(0))
+				minimumDot = glm::min(minimumDot, glm::dot(n, cluster.coneAxis));
+		cluster.coneCutoff = minimumDot > 0 ? std::sqrt(1 - minimumDot * minimumDot) : 2.0f;
+
+		clusters.push_back(cluster);
+
+		first = last;
+		normalSum = glm::vec3(0);
+		normals.clear();
+	};
+
+	// walk the triangles in the order they are drawn, so a vertex cache sort
+	// beforehand is kept, and a cluster ends when it is full or the next
+	// triangle would widen its cone too far
+	for (size_t t = 0; t < triangleCount; ++t) {
+		glm::vec3 n = normal(t);
+
+		size_t size = t - first;
+		if (size >= maxTriangles ||
+			(size >= minTriangles &&
+			 n != glm::vec3(0) &&
+			 glm::dot(n, normalSum) < CONE_COSINE * glm::length(normalSum)))
+			close(t);
+
+		normals.push_back(n);
+		normalSum += n;
+	}
+
+	close(triangleCount);
+}
+
+size_t simplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+					const float* positions, const float* normals, size_t vertexStride, size_t vertexCount,
+					size_t targetIndexCount, float maxError, float* resultError /* = nullptr */) {
+
+	// collapses between vertices whose normals are further apart than this are rejected
+	const float NORMAL_COSINE = 0.5f;
+
+	// how much more the planes along a seam count than the surface, keeping the
+	// seam's shape while its vertices collapse along it
+	const float SEAM_WEIGHT = 10.0f;
+
+	std::vector<unsigned int> result(indices, indices + indexCount / 3 * 3);
+	if (resultError != nullptr)
+		*resultError = 0;
+
+	auto position = [&](unsigned int v) {
+		return readPosition(positions, vertexStride, v);
+	};
+	auto normal = [&](unsigned int v) {
+		return readPosition(normals, vertexStride, v);
+	};
+
+	std::vector<unsigned int> positionID;
+	unsigned int positionCount = buildPositionIDs(positions, vertexStride, vertexCount, positionID);
+
+	// the vertices at each position, more than one where the position is on a seam
+	std::vector<unsigned int> wedgeOffsets(positionCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		++wedgeOffsets[positionID[v] + 1];
+	for (unsigned int p = 0; p < positionCount; ++p)
+		wedgeOffsets[p + 1] += wedgeOffsets[p];
+	std::vector<unsigned int> wedges(vertexCount);
+	{
+		std::vector<unsigned int> fill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+		for (size_t v = 0; v < vertexCount; ++v)
+			wedges[fill[positionID[v]]++] = (unsigned int)v;
+	}
+
+	// open borders and non-manifold edges, any edge not shared by exactly 2
+	// triangles, are locked in place
+	struct HalfEdge {
+		unsigned long long	key;
+		unsigned int		triangle;
+		unsigned int		from, to;
+	};
+
+	std::vector<HalfEdge> edges;
+	edges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (unsigned int j = 0; j < 3; ++j) {
+			unsigned int from = result[i + j];
+			unsigned int to = result[i + (j + 1) % 3];
+			unsigned long long a = positionID[from];
+			unsigned long long b = positionID[to];
+			HalfEdge edge = { a < b ? (a << 32) | b : (b << 32) | a, (unsigned int)(i / 3), from, to };
+			edges.push_back(edge);
+		}
+	}
+	std::sort(edges.begin(), edges.end(), [](const HalfEdge& a, const HalfEdge& b) {
+		return a.key < b.key;
+	});
+
+	std::vector<unsigned char> locked(positionCount, 0);
+	std::vector<HalfEdge> seams;
+	for (size_t i = 0; i < edges.size();) {
+		size_t run = i + 1;
+		while (run < edges.size() &&
+			   edges[run].key == edges[i].key)
+			++run;
+
+		if (run - i != 2) {
+			locked[(unsigned int)(edges[i].key >> 32)] = 1;
+			locked[(unsigned int)(edges[i].key & 0xffffffff)] = 1;
+		}
+		else if (edges[i].from != edges[i + 1].to ||
+				 edges[i].to != edges[i + 1].from) {
+			// the triangles either side use different vertices, a uv or normal seam
+			seams.push_back(edges[i]);
+			seams.push_back(edges[i + 1]);
+		}
+		i = run;
+	}
+
+	// every position starts with the planes of the triangles around it
+	std::vector<Quadric> quadrics(positionCount, Quadric());
+	std::vector<glm::vec3> triangleNormals(result.size() / 3);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		glm::vec3 p0 = position(result[i]);
+		glm::vec3 n = glm::cross(position(result[i + 1]) - p0, position(result[i + 2]) - p0);
+		float length = glm::length(n);
+		if (length == 0)
+			continue;
+		n /= length;
+		triangleNormals[i / 3] = n;
+
+		for (unsigned int j = 0; j < 3; ++j)
+			quadrics[positionID[result[i + j]]].addPlane(n, -glm::dot(n, p0), length * 0.5f);
+	}
+
+	// and seams add planes at right angles to the triangles along them, so
+	// moving a seam vertex off the line of the seam costs more than the surface
+	for (auto& seam : seams) {
+		glm::vec3 p0 = position(seam.from);
+		glm::vec3 edge = position(seam.to) - p0;
+		glm::vec3 n = glm::cross(edge, triangleNormals[seam.triangle]);
+		float length = glm::length(n);
+		if (length == 0)
+			continue;
+		n /= length;
+
+		float weight = glm::dot(edge, edge) * SEAM_WEIGHT;
+		quadrics[positionID[seam.from]].addPlane(n, -glm::dot(n, p0), weight);
+		quadrics[positionID[seam.to]].addPlane(n, -glm::dot(n, p0), weight);
+	}
+
+	// collapses move every vertex at one position on to a vertex at the other
+	struct Collapse {
+		unsigned int	from, to;	// position ids
+		float			error;		// mean squared distance to the merged planes
+	};
+
+	double maxErrorSquared = (double)maxError * maxError;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> adjacencyOffsets;
+	std::vector<unsigned int> adjacency;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned int> targets;
+	std::vector<unsigned char> touched(positionCount);
+
+	while (result.size() > targetIndexCount) {
+
+		// triangles that use each vertex
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (auto v : result)
+			++adjacencyOffsets[v + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i)
+			adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+
+		// every way an edge could collapse, cheapest first
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (unsigned int j = 0; j < 6; ++j) {
+				unsigned int fromID = positionID[result[i + j % 3]];
+				unsigned int toID = positionID[result[i + (j + 1 + j / 3) % 3]];
+				if (locked[fromID] ||
+					fromID == toID)
+					continue;
+
+				Quadric merged = quadrics[fromID];
+				merged.add(quadrics[toID]);
+				double error = merged.weight > 0 ? merged.evaluate(position(wedges[wedgeOffsets[toID]])) / merged.weight : 0;
+				if (error <= maxErrorSquared) {
+					Collapse collapse = { fromID, toID, (float)glm::max(error, 0.0) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.error < b.error;
+		});
+
+		// take as many as possible without two touching the same triangles
+		for (size_t v = 0; v < vertexCount; ++v)
+			remap[v] = (unsigned int)v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		size_t triangleCount = result.size() / 3;
+		size_t collapseCount = 0;
+		for (auto& collapse : collapses) {
+			if (triangleCount <= targetIndexCount / 3)
+				break;
+
+			if (touched[collapse.from] ||
+				touched[collapse.to])
+				continue;
+
+			// each vertex at the position must share its triangles with exactly
+			// one vertex at the other end, otherwise the collapse would drag the
+			// attributes across a seam
+			targets.clear();
+			bool valid = true;
+			for (unsigned int w = wedgeOffsets[collapse.from]; w < wedgeOffsets[collapse.from + 1] && valid; ++w) {
+				unsigned int from = wedges[w];
+				unsigned int to = ~0u;
+				for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && valid; ++a) {
+					const unsigned int* triangle = &result[adjacency[a] * 3];
+					for (unsigned int j = 0; j < 3; ++j) {
+						if (positionID[triangle[j]] != collapse.to)
+							continue;
+						if (to != ~0u &&
+							to != triangle[j])
+							valid = false;
+						to = triangle[j];
+					}
+				}
+
+				// vertices no longer used by any triangle can stay where they are
+				if (to == ~0u &&
+					adjacencyOffsets[from] != adjacencyOffsets[from + 1])
+					valid = false;
+
+				glm::vec3 fromNormal = normal(from);
+				glm::vec3 toNormal = to != ~0u ? normal(to) : fromNormal;
+				if (glm::dot(fromNormal, toNormal) < NORMAL_COSINE * glm::length(fromNormal) * glm::length(toNormal))
+					valid = false;
+
+				targets.push_back(to);
+			}
+			if (valid == false)
+				continue;
+
+			// moving the position mustn't flip any of the triangles that keep it
+			bool flips = false;
+			size_t removed = 0;
+			glm::vec3 target = position(wedges[wedgeOffsets[collapse.to]]);
+			for (unsigned int w = wedgeOffsets[collapse.from]; w < wedgeOffsets[collapse.from + 1] && flips == false; ++w) {
+				unsigned int from = wedges[w];
+				for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && flips == false; ++a) {
+					const unsigned int* triangle = &result[adjacency[a] * 3];
+					if (positionID[triangle[0]] == collapse.to ||
+						positionID[triangle[1]] == collapse.to ||
+						positionID[triangle[2]] == collapse.to) {
+						++removed;
+						continue;
+					}
+
+					glm::vec3 p[3] = { position(triangle[0]), position(triangle[1]), position(triangle[2]) };
+					glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					for (unsigned int j = 0; j < 3; ++j)
+						if (triangle[j] == from)
+							p[j] = target;
+					glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+					flips = glm::dot(before, after) <= 0;
+				}
+			}
+			if (flips)
+				continue;
+
+			// nothing around either end can change again this pass
+			for (unsigned int w = wedgeOffsets[collapse.from]; w < wedgeOffsets[collapse.from + 1]; ++w) {
+				unsigned int from = wedges[w];
+				for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a) {
+					const unsigned int* triangle = &result[adjacency[a] * 3];
+					touched[positionID[triangle[0]]] = 1;
+					touched[positionID[triangle[1]]] = 1;
+					touched[positionID[triangle[2]]] = 1;
+				}
+
+				if (targets[w - wedgeOffsets[collapse.from]] != ~0u)
+					remap[from] = targets[w - wedgeOffsets[collapse.from]];
+			}
+
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			if (resultError != nullptr)
+				*resultError = glm::max(*resultError, std::sqrt(collapse.error));
+
+			triangleCount -= removed;
+			++collapseCount;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// apply the collapses and drop the triangles they closed up
+		size_t kept = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			unsigned int a = remap[result[i]];
+			unsigned int b = remap[result[i + 1]];
+			unsigned int c = remap[result[i + 2]];
+			if (positionID[a] == positionID[b] ||
+				positionID[b] == positionID[c] ||
+				positionID[c] == positionID[a])
+				continue;
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+		result.resize(kept);
+	}
+
+	memcpy(destination, result.data(), result.size() * sizeof(unsigned int));
+	return result.size();
+}
+
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize,
+						   unsigned int* indices, size_t indexCount) {
+
+	const unsigned int UNUSED = ~0u;
+
+	std::vector<unsigned int> remap(vertexCount, UNUSED);
+	unsigned int used = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		unsigned int& v = remap[indices[i]];
+		if (v == UNUSED)
+			v = used++;
+		indices[i] = v;
+	}
+
+	std::vector<unsigned char> source((unsigned char*)vertices, (unsigned char*)vertices + vertexCount * vertexSize);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] != UNUSED)
+			memcpy((unsigned char*)vertices + remap[v] * vertexSize, source.data() + v * vertexSize, vertexSize);
+	}
+
+	return used;
+}
+
+} // namespace aie
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "BoundingSphere.h"
+
+// triangle and vertex reordering for indexed triangle lists
+// none of these change what is drawn, only the order it is drawn in
+
+namespace aie {
+
+// post-transform vertex cache statistics
+struct VertexCacheStats {
+	size_t	transformedCount;	// vertices sent through the vertex shader
+	size_t	triangleCount;
+	size_t	vertexCount;
+
+	float	acmr;	// average cache miss ratio, transformed vertices per triangle (0.5 at best, 3 at worst)
+	float	atvr;	// average transformed vertex ratio, transformed vertices per vertex (1 at best)
+};
+
+// simulates a fifo post-transform cache with cacheSize entries
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount,
+									size_t vertexCount, unsigned int cacheSize = 16);
+
+// reorders triangles for post-transform cache reuse using Tipsify
+// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+// clusters receives the first index of each run of triangles that starts from a
+// cache miss, which optimizeOverdraw can then reorder without losing much reuse
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount,
+						 unsigned int cacheSize = 16, std::vector<unsigned int>* clusters = nullptr);
+
+// sorts clusters so the ones facing out from the middle of the mesh are drawn
+// first, which occlude the rest from most view directions
+// positions are read as 3 floats every positionStride bytes
+void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+					  const float* positions, size_t positionStride,
+					  const std::vector<unsigned int>& clusters);
+
+// reduces the triangle count towards targetIndexCount / 3 by collapsing edges
+// in order of least quadric error (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics"), without moving any collapse
+// further than maxError from the original surface
+// vertices only ever collapse on to other vertices, so the vertex buffer is
+// kept as it is and only the indices change
+// seams are wherever neighbouring triangles use different vertices, so
+// duplicate vertices should be welded first
+// vertices split along uv or normal seams only collapse along the seam, both
+// sides together, and open borders never move
+// collapses that would flip a triangle or join vertices whose normals differ
+// by more than 60 degrees are skipped
+// destination may be the same as indices, returns the new index count and
+// the largest error of any collapse in resultError
+size_t simplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+					const float* positions, const float* normals, size_t vertexStride, size_t vertexCount,
+					size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+// reorders vertices in to the order they are first used by the indices so that
+// vertex fetches walk memory forwards, unused vertices are dropped
+// returns the number of vertices left
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize,
+						   unsigned int* indices, size_t indexCount);
+
+// a run of consecutive triangles that can be culled together
+struct MeshCluster {
+	unsigned int	firstIndex;
+	unsigned int	indexCount;
+
+	BoundingSphere	bounds;
+
+	// every triangle faces within the cone around coneAxis, coneCutoff is the
+	// sine of its half angle, or above 1 when the cone is too wide to cull with
+	glm::vec3		coneAxis;
+	float			coneCutoff;
+
+	// true when every triangle in the cluster faces away from the camera
+	bool isBackFacing(const glm::vec3& cameraPosition) const {
+		glm::vec3 toCluster = bounds.centre - cameraPosition;
+		return glm::dot(toCluster, coneAxis) >= coneCutoff * glm::length(toCluster) + bounds.radius;
+	}
+};
+
+// a simplified copy of a mesh's triangles, kept in the same index buffer
+struct MeshLevelOfDetail {
+	unsigned int	firstIndex;
+	unsigned int	indexCount;
+
+	// furthest the level strays from the full mesh, in the mesh's units
+	float			error;
+};
+
+// splits the triangles in to clusters of consecutive runs of up to
+// maxTriangles, without reordering them, so run it after optimizeVertexCache
+// whose runs of neighbouring triangles make compact clusters
+// a cluster ends early at a triangle that would widen its normal cone too far
+// once it has minTriangles
+void buildClusters(const unsigned int* indices, size_t indexCount,
+				   const float* positions, size_t positionStride,
+				   std::vector<MeshCluster>& clusters,
+				   unsigned int minTriangles = 64, unsigned int maxTriangles = 128);
+
+// optimizeOverdraw for clusters from buildClusters, which keeps each cluster
+// as one range and moves its firstIndex along with its triangles
+void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+					  const float* positions, size_t positionStride,
+					  std::vector<MeshCluster>& clusters);
+
+} // namespace aie
@@ -1,275 +1,629 @@
 #include "OBJMesh.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Shader.h"
+#include "TextureBatch.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
 #include "gl_core_4_4.h"
 #include <glm/geometric.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define OBJMESH_SSE
+#endif
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 namespace aie {
 
-OBJMesh::~OBJMesh() {
-	for (auto& c : m_meshChunks) {
-		glDeleteVertexArrays(1, &c.vao);
-		glDeleteBuffers(1, &c.vbo);
-		glDeleteBuffers(1, &c.ibo);
-	}
+namespace {
+
+// binary mesh cache layout, all records are 4-byte aligned so that
+// vertex and index data can be handed straight to glBufferData
+//
+//	CacheHeader
+//	CacheChunk * chunkCount (each followed by its vertices, indices (padded), clusters then levels of detail)
+//	CacheMaterial * materialCount (each followed by its texture names)
+//	CacheMaterialFile * materialFileCount (each followed by its name)
+//
+// chunks come first so a streamed load can write each one as it is parsed,
+// the materials are only known once the whole obj has been read
+// the obj and every mtl file it names are stamped, so editing any of them
+// makes the cache stale
+//
+// bump the version whenever the layout, OBJMesh::Vertex or OBJMesh::PackedVertex changes,
+// or the way chunks are processed does
+const char			CACHE_MAGIC[4] = { 'A', 'I', 'E', 'M' };
+const unsigned int	CACHE_VERSION = 9;
+const char*			CACHE_EXTENSION = ".meshcache";
+
+const unsigned int	CACHE_FLAG_FLIP_V = 1 << 0;
+const unsigned int	CACHE_FLAG_OPTIMIZED = 1 << 1;
+const unsigned int	CACHE_FLAG_PACKED = 1 << 2;
+
+// material texture names are stored in bound slot order
+const unsigned int	TEXTURE_SLOT_COUNT = 7;
+
+std::shared_ptr<Texture> OBJMesh::Material::* const TEXTURE_SLOTS[TEXTURE_SLOT_COUNT] = {
+	&OBJMesh::Material::diffuseTexture,
+	&OBJMesh::Material::alphaTexture,
+	&OBJMesh::Material::ambientTexture,
+	&OBJMesh::Material::specularTexture,
+	&OBJMesh::Material::specularHighlightTexture,
+	&OBJMesh::Material::normalTexture,
+	&OBJMesh::Material::displacementTexture,
+};
+
+// the handle of a material texture, or 0 if it has none or isn't uploaded yet
+unsigned int textureHandle(const std::shared_ptr<Texture>& texture) {
+	return texture != nullptr ? texture->getHandle() : 0;
 }
 
-bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */) {
+// sampler uniforms in bound slot order
+const char* const TEXTURE_UNIFORMS[TEXTURE_SLOT_COUNT] = {
+	"diffuseTexture",
+	"alphaTexture",
+	"ambientTexture",
+	"specularTexture",
+	"specularHighlightTexture",
+	"normalTexture",
+	"displacementTexture",
+};
+
+// matches the std140 layout of the Material block in Phong.frag
+struct MaterialBlock {
+	float	ambient[3];			// Ka
+	float	opacity;
+	float	diffuse[3];			// Kd
+	float	specularPower;
+	float	specular[3];		// Ks
+	float	padding0;
+	float	emissive[3];		// Ke
+	float	padding1;
+};
+
+// uniform buffer binding point the Material block is read through
+const unsigned int	MATERIAL_BLOCK_BINDING = 0;
+
+// matches the std430 Instance struct in Phong.vert, the normal matrix
+// is a mat4 to keep the columns aligned the same in both
+struct InstanceTransform {
+	glm::mat4	model;
+	glm::mat4	normal;
+};
+
+// shader storage binding point the Instances block is read through
+const unsigned int	INSTANCE_BLOCK_BINDING = 0;
+
+// instance transforms written by each job of an instanced draw
+const unsigned int	INSTANCES_PER_JOB = 1024;
+
+// where a program keeps the uniforms a mesh draw sets, -1 for those it lacks
+// programs with a Material block read the material from the mesh's buffer
+// instead of the loose colour uniforms
+struct MaterialUniforms {
+	int		materialBlock;
+	int		ka;
+	int		kd;
+	int		ks;
+	int		ke;
+	int		opacity;
+	int		specularPower;
+	int		textures[TEXTURE_SLOT_COUNT];
+	int		packedVertices;
+
+	// last value given to packedVertices, -1 before the first draw
+	int		packedValue;
+};
+
+// keyed by program handle, only touched on the thread that owns the opengl
+// context, and emptied whenever any ShaderProgram links
+std::unordered_map<int, MaterialUniforms>	s_materialUniforms;
+unsigned int								s_materialUniformsLinkCount = 0;
+
+// looks the uniforms up the first time program draws a mesh, program must be
+// the one in use so its samplers can be pointed at their slots then
+MaterialUniforms& getMaterialUniforms(int program) {
+
+	// a relinked program can have moved its uniforms, or another program can
+	// have been given a deleted one's handle
+	if (s_materialUniformsLinkCount != ShaderProgram::getLinkCount()) {
+		s_materialUniformsLinkCount = ShaderProgram::getLinkCount();
+		s_materialUniforms.clear();
+	}
 
-	if (m_meshChunks.empty() == false) {
-		printf("Mesh already initialised, can't re-initialise!\n");
-		return false;
+	auto found = s_materialUniforms.find(program);
+	if (found != s_materialUniforms.end())
+		return found->second;
+
+	MaterialUniforms& uniforms = s_materialUniforms[program];
+
+	uniforms.materialBlock = -1;
+	unsigned int blockIndex = glGetUniformBlockIndex(program, "Material");
+	if (blockIndex != GL_INVALID_INDEX) {
+		int blockSize = 0;
+		glGetActiveUniformBlockiv(program, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+		if (blockSize <= (int)sizeof(MaterialBlock)) {
+			glUniformBlockBinding(program, blockIndex, MATERIAL_BLOCK_BINDING);
+			uniforms.materialBlock = (int)blockIndex;
+		}
+		else
+			printf("Material uniform block is larger than an OBJMesh material!\n");
 	}
 
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string error = "";
+	uniforms.ka = glGetUniformLocation(program, "Ka");
+	uniforms.kd = glGetUniformLocation(program, "Kd");
+	uniforms.ks = glGetUniformLocation(program, "Ks");
+	uniforms.ke = glGetUniformLocation(program, "Ke");
+	uniforms.opacity = glGetUniformLocation(program, "opacity");
+	uniforms.specularPower = glGetUniformLocation(program, "specularPower");
+	uniforms.packedVertices = glGetUniformLocation(program, "PackedVertices");
+	uniforms.packedValue = -1;
+
+	// texture slots don't change per material, or per draw
+	for (unsigned int i = 0; i < TEXTURE_SLOT_COUNT; ++i) {
+		uniforms.textures[i] = glGetUniformLocation(program, TEXTURE_UNIFORMS[i]);
+		if (uniforms.textures[i] >= 0)
+			glUniform1i(uniforms.textures[i], i);
+	}
 
-	std::string file = filename;
-	std::string folder = file.substr(0, file.find_last_of('/') + 1);
+	return uniforms;
+}
 
-	bool success = tinyobj::LoadObj(shapes, materials, error,
-									filename, folder.c_str());
+struct CacheHeader {
+	char				magic[4];
+	unsigned int		version;
+	unsigned int		flags;
+	unsigned int		vertexSize;
+	unsigned long long	sourceSize;
+	long long			sourceTime;
+	unsigned int		materialCount;
+	unsigned int		chunkCount;
+	unsigned int		materialFileCount;
+	unsigned int		padding;
+};
+
+struct CacheMaterial {
+	float			ambient[3];
+	float			diffuse[3];
+	float			specular[3];
+	float			emissive[3];
+	float			specularPower;
+	float			opacity;
+	unsigned int	textureNameLength[TEXTURE_SLOT_COUNT];
+};
+
+struct CacheMaterialFile {
+	unsigned long long	size;
+	long long			time;
+	unsigned int		nameLength;
+	unsigned int		padding;
+};
+
+struct CacheChunk {
+	int				materialID;
+	unsigned int	vertexCount;
+	unsigned int	indexCount;
+	unsigned int	indexSize;
+	unsigned int	clusterCount;
+	unsigned int	lodCount;
+	float			positionOffset[3];
+	float			positionScale[3];
+	float			centre[3];
+	float			radius;
+};
+
+struct CacheCluster {
+	unsigned int	firstIndex;
+	unsigned int	indexCount;
+	float			centre[3];
+	float			radius;
+	float			coneAxis[3];
+	float			coneCutoff;
+};
+
+struct CacheLOD {
+	unsigned int	firstIndex;
+	unsigned int	indexCount;
+	float			error;
+};
+
+unsigned int cacheFlags(OBJMesh::VertexFormat format, bool flipTextureV, bool optimize) {
+	return (flipTextureV ? CACHE_FLAG_FLIP_V : 0) |
+		   (optimize ? CACHE_FLAG_OPTIMIZED : 0) |
+		   (format == OBJMesh::PACKED_VERTEX ? CACHE_FLAG_PACKED : 0);
+}
 
-	if (success == false) {
-		printf("%s\n", error.c_str());
+size_t vertexSize(OBJMesh::VertexFormat format) {
+	return format == OBJMesh::PACKED_VERTEX ? sizeof(OBJMesh::PackedVertex) : sizeof(OBJMesh::Vertex);
+}
+
+// chunks that can reach every vertex with 16 bits store their indices in 16 bits
+const unsigned int	MAX_SHORT_INDEX_VERTICES = 0x10000;
+
+unsigned int indexSize(unsigned int vertexCount) {
+	return vertexCount <= MAX_SHORT_INDEX_VERTICES ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+unsigned int indexType(unsigned int indexSize) {
+	return indexSize == sizeof(unsigned short) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t cachePadding(size_t size) {
+	return (4 - (size & 3)) & 3;
+}
+
+// size and modification time of the source obj, used to spot a stale cache
+bool getSourceStamp(const char* filename, unsigned long long& size, long long& time) {
+	struct stat info;
+	if (stat(filename, &info) != 0)
 		return false;
-	}
+	size = (unsigned long long)info.st_size;
+	time = (long long)info.st_mtime;
+	return true;
+}
 
-	m_filename = filename;
+// as above for an mtl file, which may be missing as the obj still loads
+// without it, so that it turning up later also makes the cache stale
+void getMaterialFileStamp(const std::string& filename, unsigned long long& size, long long& time) {
+	if (getSourceStamp(filename.c_str(), size, time) == false) {
+		size = 0;
+		time = -1;
+	}
+}
 
-	// copy materials
-	m_materials.resize(materials.size());
-	int index = 0;
-	for (auto& m : materials) {
+// streams the processed mesh out to the cache while it is being built
+// the header is written last so a partially written cache is never accepted
+class CacheWriter {
+public:
 
-		m_materials[index].ambient = glm::vec3(m.ambient[0], m.ambient[1], m.ambient[2]);
-		m_materials[index].diffuse = glm::vec3(m.diffuse[0], m.diffuse[1], m.diffuse[2]);
-		m_materials[index].specular = glm::vec3(m.specular[0], m.specular[1], m.specular[2]);
-		m_materials[index].emissive = glm::vec3(m.emission[0], m.emission[1], m.emission[2]);
-		m_materials[index].specularPower = m.shininess;
-		m_materials[index].opacity = m.dissolve;
+	CacheWriter() : m_file(nullptr), m_failed(false) {}
+	~CacheWriter() {
+		if (m_file != nullptr) {
+			fclose(m_file);
+			remove(m_filename.c_str());
+		}
+	}
 
-		// textures
-		m_materials[index].alphaTexture.load((folder + m.alpha_texname).c_str());
-		m_materials[index].ambientTexture.load((folder + m.ambient_texname).c_str());
-		m_materials[index].diffuseTexture.load((folder + m.diffuse_texname).c_str());
-		m_materials[index].specularTexture.load((folder + m.specular_texname).c_str());
-		m_materials[index].specularHighlightTexture.load((folder + m.specular_highlight_texname).c_str());
-		m_materials[index].normalTexture.load((folder + m.bump_texname).c_str());
-		m_materials[index].displacementTexture.load((folder + m.displacement_texname).c_str());
+	bool begin(const char* filename, const CacheHeader& header) {
+		m_filename = filename;
+		m_header = header;
+		m_header.materialCount = 0;
+		m_header.chunkCount = 0;
+		m_header.materialFileCount = 0;
+		m_header.padding = 0;
+
+		if (fopen_s(&m_file, filename, "wb") != 0) {
+			m_file = nullptr;
+			return false;
+		}
 
-		++index;
+		CacheHeader blank;
+		memset(&blank, 0, sizeof(CacheHeader));
+		write(&blank, sizeof(CacheHeader));
+		return m_failed == false;
 	}
 
-	// copy shapes
-	m_meshChunks.reserve(shapes.size());
-	for (auto& s : shapes) {
+	void writeMaterial(const CacheMaterial& material, const std::string* textureNames) {
+		if (m_file == nullptr)
+			return;
 
-		MeshChunk chunk;
+		CacheMaterial record = material;
+		for (unsigned int i = 0; i < TEXTURE_SLOT_COUNT; ++i)
+			record.textureNameLength[i] = (unsigned int)textureNames[i].size();
+		write(&record, sizeof(CacheMaterial));
 
-		// generate buffers
-		glGenBuffers(1, &chunk.vbo);
-		glGenBuffers(1, &chunk.ibo);
-		glGenVertexArrays(1, &chunk.vao);
+		static const char padding[4] = {};
+		for (unsigned int i = 0; i < TEXTURE_SLOT_COUNT; ++i) {
+			write(textureNames[i].data(), textureNames[i].size());
+			write(padding, cachePadding(textureNames[i].size()));
+		}
 
-		// bind vertex array aka a mesh wrapper
-		glBindVertexArray(chunk.vao);
+		++m_header.materialCount;
+	}
 
-		// set the index buffer data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-					 s.mesh.indices.size() * sizeof(unsigned int),
-					 s.mesh.indices.data(), GL_STATIC_DRAW);
+	void writeMaterialFile(const std::string& name, unsigned long long size, long long time) {
+		if (m_file == nullptr)
+			return;
 
-		// store index count for rendering
-		chunk.indexCount = (unsigned int)s.mesh.indices.size();
+		CacheMaterialFile record;
+		record.size = size;
+		record.time = time;
+		record.nameLength = (unsigned int)name.size();
+		record.padding = 0;
+		write(&record, sizeof(CacheMaterialFile));
 
-		// create vertex data
-		std::vector<Vertex> vertices;
-		vertices.resize(s.mesh.positions.size() / 3);
-		size_t vertCount = vertices.size();
+		static const char padding[4] = {};
+		write(name.data(), name.size());
+		write(padding, cachePadding(name.size()));
 
-		bool hasPosition = s.mesh.positions.empty() == false;
-		bool hasNormal = s.mesh.normals.empty() == false;
-		bool hasTexture = s.mesh.texcoords.empty() == false;
+		++m_header.materialFileCount;
+	}
 
-		for (size_t i = 0; i < vertCount; ++i) {
-			if (hasPosition)
-				vertices[i].position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
-			if (hasNormal)
-				vertices[i].normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
+	void writeChunk(const void* vertices, unsigned int vertexCount,
+					const void* indices, unsigned int indexCount, unsigned int indexSize, int materialID,
+					const glm::vec3& positionOffset, const glm::vec3& positionScale, const BoundingSphere& bounds,
+					const std::vector<MeshCluster>& clusters, const std::vector<MeshLevelOfDetail>& lods) {
+		if (m_file == nullptr)
+			return;
+
+		CacheChunk record;
+		record.materialID = materialID;
+		record.vertexCount = vertexCount;
+		record.indexCount = indexCount;
+		record.indexSize = indexSize;
+		record.clusterCount = (unsigned int)clusters.size();
+		record.lodCount = (unsigned int)lods.size();
+		memcpy(record.positionOffset, &positionOffset[0], sizeof(float) * 3);
+		memcpy(record.positionScale, &positionScale[0], sizeof(float) * 3);
+		memcpy(record.centre, &bounds.centre[0], sizeof(float) * 3);
+		record.radius = bounds.radius;
+
+		write(&record, sizeof(CacheChunk));
+		write(vertices, vertexCount * m_header.vertexSize);
+		write(indices, indexCount * indexSize);
+
+		static const char padding[4] = {};
+		write(padding, cachePadding(indexCount * indexSize));
+
+		for (auto& cluster : clusters) {
+			CacheCluster clusterRecord;
+			clusterRecord.firstIndex = cluster.firstIndex;
+			clusterRecord.indexCount = cluster.indexCount;
+			memcpy(clusterRecord.centre, &cluster.bounds.centre[0], sizeof(float) * 3);
+			clusterRecord.radius = cluster.bounds.radius;
+			memcpy(clusterRecord.coneAxis, &cluster.coneAxis[0], sizeof(float) * 3);
+			clusterRecord.coneCutoff = cluster.coneCutoff;
+			write(&clusterRecord, sizeof(CacheCluster));
+		}
 
-			// flip the T / V (might not always be needed, depends on how mesh was made)
-			if (hasTexture)
-				vertices[i].texcoord = glm::vec2(s.mesh.texcoords[i * 2 + 0], flipTextureV ? 1.0f - s.mesh.texcoords[i * 2 + 1] : s.mesh.texcoords[i * 2 + 1]);
+		for (auto& lod : lods) {
+			CacheLOD lodRecord;
+			lodRecord.firstIndex = lod.firstIndex;
+			lodRecord.indexCount = lod.indexCount;
+			lodRecord.error = lod.error;
+			write(&lodRecord, sizeof(CacheLOD));
 		}
 
-		// calculate for normal mapping
-		if (hasNormal && hasTexture)
-			calculateTangents(vertices, s.mesh.indices);
+		++m_header.chunkCount;
+	}
+
+	bool end() {
+		if (m_file == nullptr)
+			return false;
 
-		// bind vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		fseek(m_file, 0, SEEK_SET);
+		write(&m_header, sizeof(CacheHeader));
+
+		if (fclose(m_file) != 0)
+			m_failed = true;
+		m_file = nullptr;
+
+		if (m_failed)
+			remove(m_filename.c_str());
+		return m_failed == false;
+	}
 
-		// fill vertex buffer
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+private:
+
+	void write(const void* data, size_t size) {
+		if (size > 0 &&
+			fwrite(data, 1, size, m_file) != size)
+			m_failed = true;
+	}
+
+	std::string	m_filename;
+	FILE*		m_file;
+	bool		m_failed;
+	CacheHeader	m_header;
+};
+
+// entries in the post-transform cache that chunks are optimized for, a
+// conservative size that suits older hardware without hurting newer
+const unsigned int	VERTEX_CACHE_SIZE = 16;
+
+// the overdraw order is only kept if it transforms at most this many times the
+// vertices of the cache order, and no more than the order the obj was in, as
+// it breaks the cache's runs wherever it moves a cluster
+const float			OVERDRAW_THRESHOLD = 1.05f;
+
+// every mesh with the same vertex format shares one arena, created on first
+// use from the thread that owns the opengl context
+GeometryArena& getArena(OBJMesh::VertexFormat format) {
+
+	static GeometryArena fullArena(sizeof(OBJMesh::Vertex), []() {
+		for (unsigned int i = 0; i < 4; ++i) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribBinding(i, 0);
+		}
 
 		// enable first element as positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+		glVertexAttribFormat(0, 4, GL_FLOAT, GL_FALSE, offsetof(OBJMesh::Vertex, position));
 
 		// enable normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 1));
+		glVertexAttribFormat(1, 4, GL_FLOAT, GL_TRUE, offsetof(OBJMesh::Vertex, normal));
 
 		// enable texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2));
+		glVertexAttribFormat(2, 2, GL_FLOAT, GL_FALSE, offsetof(OBJMesh::Vertex, texcoord));
 
 		// enable tangents
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
+		glVertexAttribFormat(3, 4, GL_FLOAT, GL_FALSE, offsetof(OBJMesh::Vertex, tangent));
+	});
 
-		// bind 0 for safety
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	static GeometryArena packedArena(sizeof(OBJMesh::PackedVertex), []() {
+		for (unsigned int i = 0; i < 4; ++i) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribBinding(i, 0);
+		}
 
-		// set chunk material
-		chunk.materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
+		// positions and handedness
+		glVertexAttribFormat(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(OBJMesh::PackedVertex, position));
+
+		// octahedral normals and tangents
+		glVertexAttribFormat(1, 2, GL_SHORT, GL_TRUE, offsetof(OBJMesh::PackedVertex, normal));
+		glVertexAttribFormat(3, 2, GL_SHORT, GL_TRUE, offsetof(OBJMesh::PackedVertex, tangent));
+
+		// half float texture coords
+		glVertexAttribFormat(2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(OBJMesh::PackedVertex, texcoord));
+	});
 
-		m_meshChunks.push_back(chunk);
+	return format == OBJMesh::PACKED_VERTEX ? packedArena : fullArena;
+}
+
+// levels of detail per chunk including the full mesh, each one aiming for half
+// the triangles of the last
+const unsigned int	LOD_COUNT = 4;
+
+// a level is only kept if it has at least this many triangles, and removes at
+// least LOD_MIN_REDUCTION of the triangles of the level before it
+const unsigned int	LOD_MIN_TRIANGLES = 64;
+const float			LOD_MIN_REDUCTION = 0.1f;
+
+// furthest a level may stray from the full mesh, relative to the chunk's radius
+const float			LOD_MAX_ERROR = 0.1f;
+
+// simplifies the full mesh in indices in to each further level of detail,
+// appending their indices after it
+void buildLevelsOfDetail(const std::vector<OBJMesh::Vertex>& vertices, std::vector<unsigned int>& indices,
+						 float radius, bool optimize, std::vector<MeshLevelOfDetail>& lods) {
+
+	MeshLevelOfDetail full = { 0, (unsigned int)indices.size(), 0 };
+	lods.push_back(full);
+
+	// objs often list the same vertex more than once, which would look like a
+	// seam, so the simplifier is given the first copy of each (tangents are
+	// ignored as they are generated per copy)
+	const size_t attributeSize = offsetof(OBJMesh::Vertex, tangent);
+	std::vector<unsigned int> sortedVertices(vertices.size());
+	for (size_t v = 0; v < vertices.size(); ++v)
+		sortedVertices[v] = (unsigned int)v;
+	std::sort(sortedVertices.begin(), sortedVertices.end(), [&](unsigned int a, unsigned int b) {
+		int order = memcmp(&vertices[a], &vertices[b], attributeSize);
+		return order != 0 ? order < 0 : a < b;
+	});
+
+	std::vector<unsigned int> firstCopy(vertices.size());
+	for (size_t i = 0; i < sortedVertices.size(); ++i) {
+		unsigned int v = sortedVertices[i];
+		firstCopy[v] = v;
+		if (i > 0 &&
+			memcmp(&vertices[v], &vertices[sortedVertices[i - 1]], attributeSize) == 0)
+			firstCopy[v] = firstCopy[sortedVertices[i - 1]];
+	}
+
+	std::vector<unsigned int> welded(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+		welded[i] = firstCopy[indices[i]];
+
+	// every level starts from the full mesh so that its error is measured against it
+	std::vector<unsigned int> level(indices.size());
+	for (unsigned int i = 1; i < LOD_COUNT; ++i) {
+		size_t target = (size_t)full.indexCount >> i;
+		if (target < LOD_MIN_TRIANGLES * 3)
+			break;
+
+		float error = 0;
+		size_t levelCount = simplifyMesh(level.data(), welded.data(), welded.size(),
+										 &vertices[0].position.x, &vertices[0].normal.x, sizeof(OBJMesh::Vertex), vertices.size(),
+										 target / 3 * 3, radius * LOD_MAX_ERROR, &error);
+		if (levelCount > lods.back().indexCount * (1 - LOD_MIN_REDUCTION))
+			break;
+
+		if (optimize)
+			optimizeVertexCache(level.data(), levelCount, vertices.size(), VERTEX_CACHE_SIZE);
+
+		MeshLevelOfDetail lod = { (unsigned int)indices.size(), (unsigned int)levelCount, error };
+		lods.push_back(lod);
+		indices.insert(indices.end(), level.begin(), level.begin() + levelCount);
 	}
-	
-	// load obj
-	return true;
 }
 
-void OBJMesh::draw(bool usePatches /* = false */) {
+// octahedral encodes a unit vector in to 2 snorm16s, folding the lower
+// hemisphere over the upper, zero length vectors come out as +z
+void packOctahedral(const glm::vec4& v, short* result) {
+	float sum = glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z);
+	glm::vec2 p(0);
+	if (sum > 0) {
+		p = glm::vec2(v.x, v.y) / sum;
+		if (v.z < 0)
+			p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0 ? 1 : -1, p.y >= 0 ? 1 : -1);
+	}
+	result[0] = (short)glm::packSnorm1x16(p.x);
+	result[1] = (short)glm::packSnorm1x16(p.y);
+}
 
-	int program = -1;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+// quantises vertices to OBJMesh::PackedVertex, positions are stored relative
+// to their bounds which are returned to decode them with
+void packVertices(const OBJMesh::Vertex* vertices, size_t vertexCount, OBJMesh::PackedVertex* packed,
+				  glm::vec3& positionOffset, glm::vec3& positionScale) {
 
-	if (program == -1) {
-		printf("No shader bound!\n");
+	if (vertexCount == 0)
 		return;
+
+	glm::vec3 boundsMin(vertices[0].position);
+	glm::vec3 boundsMax(vertices[0].position);
+	for (size_t i = 1; i < vertexCount; ++i) {
+		boundsMin = glm::min(boundsMin, glm::vec3(vertices[i].position));
+		boundsMax = glm::max(boundsMax, glm::vec3(vertices[i].position));
 	}
 
-	// pull uniforms from the shader
-	int kaUniform = glGetUniformLocation(program, "Ka");
-	int kdUniform = glGetUniformLocation(program, "Kd");
-	int ksUniform = glGetUniformLocation(program, "Ks");
-	int keUniform = glGetUniformLocation(program, "Ke");
-	int opacityUniform = glGetUniformLocation(program, "opacity");
-	int specPowUniform = glGetUniformLocation(program, "specularPower");
-
-	int alphaTexUniform = glGetUniformLocation(program, "alphaTexture");
-	int ambientTexUniform = glGetUniformLocation(program, "ambientTexture");
-	int diffuseTexUniform = glGetUniformLocation(program, "diffuseTexture");
-	int specTexUniform = glGetUniformLocation(program, "specularTexture");
-	int specHighlightTexUniform = glGetUniformLocation(program, "specularHighlightTexture");
-	int normalTexUniform = glGetUniformLocation(program, "normalTexture");
-	int dispTexUniform = glGetUniformLocation(program, "displacementTexture");
-
-	// set texture slots (these don't change per material)
-	if (diffuseTexUniform >= 0)
-		glUniform1i(diffuseTexUniform, 0);
-	if (alphaTexUniform >= 0)
-		glUniform1i(alphaTexUniform, 1);
-	if (ambientTexUniform >= 0)
-		glUniform1i(ambientTexUniform, 2);
-	if (specTexUniform >= 0)
-		glUniform1i(specTexUniform, 3);
-	if (specHighlightTexUniform >= 0)
-		glUniform1i(specHighlightTexUniform, 4);
-	if (normalTexUniform >= 0)
-		glUniform1i(normalTexUniform, 5);
-	if (dispTexUniform >= 0)
-		glUniform1i(dispTexUniform, 6);
-
-	int currentMaterial = -1;
-
-	// draw the mesh chunks
-	for (auto& c : m_meshChunks) {
+	positionOffset = boundsMin;
+	positionScale = boundsMax - boundsMin;
 
-		// bind material
-		if (currentMaterial != c.materialID) {
-			currentMaterial = c.materialID;
-			if (kaUniform >= 0)
-				glUniform3fv(kaUniform, 1, &m_materials[currentMaterial].ambient[0]);
-			if (kdUniform >= 0)
-				glUniform3fv(kdUniform, 1, &m_materials[currentMaterial].diffuse[0]);
-			if (ksUniform >= 0)
-				glUniform3fv(ksUniform, 1, &m_materials[currentMaterial].specular[0]);
-			if (keUniform >= 0)
-				glUniform3fv(keUniform, 1, &m_materials[currentMaterial].emissive[0]);
-			if (opacityUniform >= 0)
-				glUniform1f(opacityUniform, m_materials[currentMaterial].opacity);
-			if (specPowUniform >= 0)
-				glUniform1f(specPowUniform, m_materials[currentMaterial].specularPower);
-
-			glActiveTexture(GL_TEXTURE0);
-			if (m_materials[currentMaterial].diffuseTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].diffuseTexture.getHandle());
-			else if (diffuseTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE1);
-			if (m_materials[currentMaterial].alphaTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].alphaTexture.getHandle());
-			else if (alphaTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE2);
-			if (m_materials[currentMaterial].ambientTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].ambientTexture.getHandle());
-			else if (ambientTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE3);
-			if (m_materials[currentMaterial].specularTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularTexture.getHandle());
-			else if (specTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE4);
-			if (m_materials[currentMaterial].specularHighlightTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularHighlightTexture.getHandle());
-			else if (specHighlightTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE5);
-			if (m_materials[currentMaterial].normalTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].normalTexture.getHandle());
-			else if (normalTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE6);
-			if (m_materials[currentMaterial].displacementTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].displacementTexture.getHandle());
-			else if (dispTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-		}
+	// flat axes quantise to 0
+	glm::vec3 inverseScale(0);
+	for (int k = 0; k < 3; ++k)
+		if (positionScale[k] > 0)
+			inverseScale[k] = 1.0f / positionScale[k];
 
-		// bind and draw geometry
-		glBindVertexArray(c.vao);
-		if (usePatches)
-			glDrawElements(GL_PATCHES, c.indexCount, GL_UNSIGNED_INT, 0);
-		else
-			glDrawElements(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const OBJMesh::Vertex& vertex = vertices[i];
+		OBJMesh::PackedVertex& result = packed[i];
+
+		glm::vec3 position = (glm::vec3(vertex.position) - positionOffset) * inverseScale;
+		result.position[0] = glm::packUnorm1x16(position.x);
+		result.position[1] = glm::packUnorm1x16(position.y);
+		result.position[2] = glm::packUnorm1x16(position.z);
+		result.position[3] = vertex.tangent.w < 0 ? 0 : 0xffff;
+
+		packOctahedral(vertex.normal, result.normal);
+		packOctahedral(vertex.tangent, result.tangent);
+
+		result.texcoord[0] = glm::packHalf1x16(vertex.texcoord.x);
+		result.texcoord[1] = glm::packHalf1x16(vertex.texcoord.y);
 	}
 }
 
-void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-	unsigned int vertexCount = (unsigned int)vertices.size();
-	glm::vec4* tan1 = new glm::vec4[vertexCount * 2];
-	glm::vec4* tan2 = tan1 + vertexCount;
-	memset(tan1, 0, vertexCount * sizeof(glm::vec4) * 2);
-
-	unsigned int indexCount = (unsigned int)indices.size();
-	for (unsigned int a = 0; a < indexCount; a += 3) {
+// per-vertex accumulators for tangent generation
+struct TangentSum {
+	glm::vec4	tangent;
+	glm::vec4	bitangent;
+};
+
+// below these tangent generation stays on fewer threads, as each extra
+// triangle job needs its own set of accumulators
+const unsigned int	TANGENT_MIN_TRIANGLES_PER_JOB = 16384;
+const unsigned int	TANGENT_MIN_BLOCKS_PER_JOB = 4096;
+
+// sums the tangent and bitangent of each triangle in [first, last) on to its vertices
+void accumulateTangents(const OBJMesh::Vertex* vertices, const unsigned int* indices,
+						unsigned int first, unsigned int last, TangentSum* sums) {
+	for (unsigned int a = first; a < last; a += 3) {
 		long i1 = indices[a];
 		long i2 = indices[a + 1];
 		long i3 = indices[a + 2];
@@ -300,30 +654,1177 @@ void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector
 		glm::vec4 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
 					   (s1 * z2 - s2 * z1) * r, 0);
 
-		tan1[i1] += sdir;
-		tan1[i2] += sdir;
-		tan1[i3] += sdir;
+		sums[i1].tangent += sdir;
+		sums[i2].tangent += sdir;
+		sums[i3].tangent += sdir;
 
-		tan2[i1] += tdir;
-		tan2[i2] += tdir;
-		tan2[i3] += tdir;
+		sums[i1].bitangent += tdir;
+		sums[i2].bitangent += tdir;
+		sums[i3].bitangent += tdir;
 	}
+}
+
+// combines the accumulators of every triangle job for the vertices in
+// [first, last) then orthogonalizes against the normal
+// the simd path works on 4 vertices at a time and gives the same results
+void orthogonalizeTangents(OBJMesh::Vertex* vertices, unsigned int first, unsigned int last,
+						   const TangentSum* sums, unsigned int vertexCount, unsigned int sumCount) {
+
+	unsigned int a = first;
+
+#ifdef OBJMESH_SSE
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; a + 4 <= last; a += 4) {
+
+		// gather 4 vertices and transpose so each register holds one component
+		__m128 nx = _mm_loadu_ps(&vertices[a + 0].normal.x);
+		__m128 ny = _mm_loadu_ps(&vertices[a + 1].normal.x);
+		__m128 nz = _mm_loadu_ps(&vertices[a + 2].normal.x);
+		__m128 nw = _mm_loadu_ps(&vertices[a + 3].normal.x);
+		_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+
+		__m128 tx = _mm_loadu_ps(&sums[a + 0].tangent.x);
+		__m128 ty = _mm_loadu_ps(&sums[a + 1].tangent.x);
+		__m128 tz = _mm_loadu_ps(&sums[a + 2].tangent.x);
+		__m128 tw = _mm_loadu_ps(&sums[a + 3].tangent.x);
+		__m128 bx = _mm_loadu_ps(&sums[a + 0].bitangent.x);
+		__m128 by = _mm_loadu_ps(&sums[a + 1].bitangent.x);
+		__m128 bz = _mm_loadu_ps(&sums[a + 2].bitangent.x);
+		__m128 bw = _mm_loadu_ps(&sums[a + 3].bitangent.x);
+		for (unsigned int j = 1; j < sumCount; ++j) {
+			const TangentSum* jobSums = sums + (size_t)vertexCount * j + a;
+			tx = _mm_add_ps(tx, _mm_loadu_ps(&jobSums[0].tangent.x));
+			ty = _mm_add_ps(ty, _mm_loadu_ps(&jobSums[1].tangent.x));
+			tz = _mm_add_ps(tz, _mm_loadu_ps(&jobSums[2].tangent.x));
+			tw = _mm_add_ps(tw, _mm_loadu_ps(&jobSums[3].tangent.x));
+			bx = _mm_add_ps(bx, _mm_loadu_ps(&jobSums[0].bitangent.x));
+			by = _mm_add_ps(by, _mm_loadu_ps(&jobSums[1].bitangent.x));
+			bz = _mm_add_ps(bz, _mm_loadu_ps(&jobSums[2].bitangent.x));
+			bw = _mm_add_ps(bw, _mm_loadu_ps(&jobSums[3].bitangent.x));
+		}
+		_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+		// Gram-Schmidt orthogonalize
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+		__m128 gx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+		__m128 gy = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+		__m128 gz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+
+		__m128 length = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), _mm_mul_ps(gz, gz));
+		__m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(length));
+		gx = _mm_mul_ps(gx, inverseLength);
+		gy = _mm_mul_ps(gy, inverseLength);
+		gz = _mm_mul_ps(gz, inverseLength);
+
+		// Calculate handedness (direction of bitangent)
+		__m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(ty, nz));
+		__m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(tz, nx));
+		__m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(tx, ny));
+		__m128 handedness = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, bx), _mm_mul_ps(cy, by)), _mm_mul_ps(cz, bz));
+		__m128 negative = _mm_cmplt_ps(handedness, zero);
+		__m128 gw = _mm_or_ps(_mm_and_ps(negative, one), _mm_andnot_ps(negative, minusOne));
+
+		_MM_TRANSPOSE4_PS(gx, gy, gz, gw);
+		_mm_storeu_ps(&vertices[a + 0].tangent.x, gx);
+		_mm_storeu_ps(&vertices[a + 1].tangent.x, gy);
+		_mm_storeu_ps(&vertices[a + 2].tangent.x, gz);
+		_mm_storeu_ps(&vertices[a + 3].tangent.x, gw);
+	}
+#endif
+
+	for (; a < last; a++) {
+		glm::vec4 tangent = sums[a].tangent;
+		glm::vec4 bitangent = sums[a].bitangent;
+		for (unsigned int j = 1; j < sumCount; ++j) {
+			tangent += sums[(size_t)vertexCount * j + a].tangent;
+			bitangent += sums[(size_t)vertexCount * j + a].bitangent;
+		}
 
-	for (unsigned int a = 0; a < vertexCount; a++) {
 		const glm::vec3& n = glm::vec3(vertices[a].normal);
-		const glm::vec3& t = glm::vec3(tan1[a]);
+		const glm::vec3& t = glm::vec3(tangent);
 
 		// Gram-Schmidt orthogonalize
 		vertices[a].tangent = glm::vec4(glm::normalize(t - n * glm::dot(n, t)), 0);
 
 		// Calculate handedness (direction of bitangent)
-		vertices[a].tangent.w = (glm::dot(glm::cross(glm::vec3(n), glm::vec3(t)), glm::vec3(tan2[a])) < 0.0F) ? 1.0F : -1.0F;
+		vertices[a].tangent.w = (glm::dot(glm::cross(glm::vec3(n), glm::vec3(t)), glm::vec3(bitangent)) < 0.0F) ? 1.0F : -1.0F;
 
 		// calculate bitangent (ignoring for our Vertex, here just for reference)
 		//vertices[a].bitangent = glm::vec4(glm::cross(glm::vec3(vertices[a].normal), glm::vec3(vertices[a].tangent)) * vertices[a].tangent.w, 0);
 		//vertices[a].tangent.w = 0;
 	}
+}
+
+// drawn for chunks without a material
+const OBJMesh::Material DEFAULT_MATERIAL;
+
+// chunk data a streamed loadAsync() can have waiting in the UploadQueue before
+// it stops parsing, the group being parsed and the one that went over come on top
+const size_t		STREAMING_UPLOAD_LIMIT = 32 * 1024 * 1024;
+
+} // namespace
 
-	delete[] tan1;
+class OBJMesh::UploadLimit : public std::enable_shared_from_this<UploadLimit> {
+public:
+
+	UploadLimit(size_t maxBytes) : m_maxBytes(maxBytes), m_queuedBytes(0), m_cancelled(false) {}
+
+	// blocks until the queued chunks are under the limit, or the load is cancelled
+	void wait() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this]() { return m_queuedBytes < m_maxBytes || m_cancelled; });
+	}
+
+	// counts bytes as queued until the returned token is destroyed, captured
+	// by an upload it lets them go once the upload has run or been dropped
+	std::shared_ptr<void> reserve(size_t bytes) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queuedBytes += bytes;
+		}
+
+		auto self = shared_from_this();
+		return std::shared_ptr<void>(nullptr, [self, bytes](void*) {
+			{
+				std::lock_guard<std::mutex> lock(self->m_mutex);
+				self->m_queuedBytes -= bytes;
+			}
+			self->m_changed.notify_all();
+		});
+	}
+
+	// lets the loading thread go for good once the mesh no longer wants its chunks
+	void cancel() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_cancelled = true;
+		}
+		m_changed.notify_all();
+	}
+
+private:
+
+	size_t					m_maxBytes;
+	size_t					m_queuedBytes;
+	bool					m_cancelled;
+	std::mutex				m_mutex;
+	std::condition_variable	m_changed;
+};
+
+OBJMesh::~OBJMesh() {
+	if (m_cancelLoad != nullptr)
+		*m_cancelLoad = true;
+	if (m_uploadLimit != nullptr)
+		m_uploadLimit->cancel();
+
+	destroyChunks();
+
+	glDeleteBuffers(1, &m_materialBuffer);
+	glDeleteBuffers(1, &m_instanceBuffer);
 }
+
+bool OBJMesh::load(const char* filename, const LoadOptions& options /* = LoadOptions() */) {
+
+	if (m_meshChunks.empty() == false ||
+		m_loading) {
+		printf("Mesh already initialised, can't re-initialise!\n");
+		return false;
+	}
+
+	// everything happens on the calling thread
+	Uploader upload = [](std::function<void()> job) { job(); };
+
+	if (loadData(filename, m_vertexFormat, options, upload, nullptr) == false)
+		return false;
+
+	m_filename = filename;
+
+	// load obj
+	return true;
+}
+
+std::shared_future<bool> OBJMesh::loadAsync(const char* filename, const LoadOptions& options /* = LoadOptions() */) {
+
+	auto result = std::make_shared<std::promise<bool>>();
+	std::shared_future<bool> future = result->get_future().share();
+
+	if (m_meshChunks.empty() == false ||
+		m_loading) {
+		printf("Mesh already initialised, can't re-initialise!\n");
+		result->set_value(false);
+		return future;
+	}
+
+	m_loading = true;
+	m_cancelLoad = std::make_shared<std::atomic<bool>>(false);
+
+	// uploads are dropped if the mesh is destroyed before they run
+	auto cancelled = m_cancelLoad;
+	Uploader upload = [cancelled](std::function<void()> job) {
+		UploadQueue::push([cancelled, job]() {
+			if (*cancelled == false)
+				job();
+		});
+	};
+
+	// without streaming the whole obj is in memory once parsed anyway
+	std::shared_ptr<UploadLimit> limit;
+	if (options.streaming)
+		limit = std::make_shared<UploadLimit>(STREAMING_UPLOAD_LIMIT);
+	m_uploadLimit = limit;
+
+	std::string file = filename;
+	VertexFormat format = m_vertexFormat;
+	ThreadPool::get().submit([this, file, format, options, upload, limit, cancelled, result]() {
+
+		bool success = *cancelled == false &&
+			loadData(file, format, options, upload, limit);
+
+		// queued behind the uploads so the future is only set once they are done
+		UploadQueue::push([this, file, success, cancelled, result]() {
+			if (*cancelled) {
+				result->set_value(false);
+				return;
+			}
+
+			m_loading = false;
+			m_uploadLimit.reset();
+			if (success)
+				m_filename = file;
+			result->set_value(success);
+		});
+	});
+
+	return future;
+}
+
+bool OBJMesh::setVertexFormat(VertexFormat format) {
+
+	if (m_meshChunks.empty() == false ||
+		m_loading) {
+		printf("Mesh already initialised, can't change vertex format!\n");
+		return false;
+	}
+
+	m_vertexFormat = format;
+	return true;
+}
+
+bool OBJMesh::loadData(const std::string& filename, VertexFormat format, const LoadOptions& options, const Uploader& upload,
+					   const std::shared_ptr<UploadLimit>& limit) {
+
+	std::string folder = filename.substr(0, filename.find_last_of('/') + 1);
+
+	// try the pre-processed mesh first
+	if (options.useCache &&
+		loadCache(filename, folder, format, options, upload))
+		return true;
+
+	// start a new cache, if it can't be written the mesh still loads
+	CacheWriter cache;
+	if (options.useCache) {
+		CacheHeader header;
+		memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = CACHE_VERSION;
+		header.flags = cacheFlags(format, options.flipTextureV, options.optimize);
+		header.vertexSize = (unsigned int)vertexSize(format);
+		if (getSourceStamp(filename.c_str(), header.sourceSize, header.sourceTime) == false ||
+			cache.begin((filename + CACHE_EXTENSION).c_str(), header) == false)
+			printf("Unable to write mesh cache for %s\n", filename.c_str());
+	}
+
+	// totals over every chunk for the optimization report
+	VertexCacheStats before = {};
+	VertexCacheStats after = {};
+
+	// turns a shape in to a mesh chunk, releasing the shape's data as it goes
+	auto addShape = [&](tinyobj::shape_t& s) {
+
+		// while streaming this also stops the parser reading any further
+		if (limit != nullptr)
+			limit->wait();
+
+		// create vertex data
+		auto vertices = std::make_shared<std::vector<Vertex>>(s.mesh.positions.size() / 3);
+		size_t vertCount = vertices->size();
+
+		bool hasPosition = s.mesh.positions.empty() == false;
+		bool hasNormal = s.mesh.normals.empty() == false;
+		bool hasTexture = s.mesh.texcoords.empty() == false;
+
+		for (size_t i = 0; i < vertCount; ++i) {
+			Vertex& vertex = (*vertices)[i];
+			if (hasPosition)
+				vertex.position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
+			if (hasNormal)
+				vertex.normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
+
+			// flip the T / V (might not always be needed, depends on how mesh was made)
+			if (hasTexture)
+				vertex.texcoord = glm::vec2(s.mesh.texcoords[i * 2 + 0], options.flipTextureV ? 1.0f - s.mesh.texcoords[i * 2 + 1] : s.mesh.texcoords[i * 2 + 1]);
+		}
+
+		// only the indices are needed from here on
+		std::vector<float>().swap(s.mesh.positions);
+		std::vector<float>().swap(s.mesh.normals);
+		std::vector<float>().swap(s.mesh.texcoords);
+
+		auto indices = std::make_shared<std::vector<unsigned int>>();
+		indices->swap(s.mesh.indices);
+
+		// calculate for normal mapping
+		if (hasNormal && hasTexture)
+			calculateTangents(*vertices, *indices);
+
+		// clusters for culling, runs of consecutive triangles
+		auto clusters = std::make_shared<std::vector<MeshCluster>>();
+
+		// reorder triangles for the post-transform cache then for overdraw if that
+		// keeps most of the cache's reuse, and vertices in to the order they are
+		// fetched, reporting the cache against the obj's own order
+		if (options.optimize &&
+			indices->empty() == false) {
+			VertexCacheStats stats = analyzeVertexCache(indices->data(), indices->size(), vertices->size(), VERTEX_CACHE_SIZE);
+			before.transformedCount += stats.transformedCount;
+			before.triangleCount += stats.triangleCount;
+			before.vertexCount += stats.vertexCount;
+
+			// clusters are cut from the cache order without changing it, then the
+			// overdraw sort moves whole clusters so they stay single ranges
+			optimizeVertexCache(indices->data(), indices->size(), vertices->size(), VERTEX_CACHE_SIZE);
+			buildClusters(indices->data(), indices->size(), &(*vertices)[0].position.x, sizeof(Vertex), *clusters);
+
+			size_t cacheSorted = analyzeVertexCache(indices->data(), indices->size(), vertices->size(), VERTEX_CACHE_SIZE).transformedCount;
+			std::vector<unsigned int> overdrawIndices(*indices);
+			std::vector<MeshCluster> overdrawClusters(*clusters);
+			optimizeOverdraw(overdrawIndices.data(), overdrawIndices.size(), &(*vertices)[0].position.x, sizeof(Vertex), overdrawClusters);
+			size_t overdrawSorted = analyzeVertexCache(overdrawIndices.data(), overdrawIndices.size(), vertices->size(), VERTEX_CACHE_SIZE).transformedCount;
+			if (overdrawSorted <= cacheSorted * OVERDRAW_THRESHOLD &&
+				overdrawSorted <= stats.transformedCount) {
+				indices->swap(overdrawIndices);
+				clusters->swap(overdrawClusters);
+			}
+
+			vertices->resize(optimizeVertexFetch(vertices->data(), vertices->size(), sizeof(Vertex), indices->data(), indices->size()));
+
+			stats = analyzeVertexCache(indices->data(), indices->size(), vertices->size(), VERTEX_CACHE_SIZE);
+			after.transformedCount += stats.transformedCount;
+			after.triangleCount += stats.triangleCount;
+			after.vertexCount += stats.vertexCount;
+		}
+		else if (indices->empty() == false) {
+			buildClusters(indices->data(), indices->size(), &(*vertices)[0].position.x, sizeof(Vertex), *clusters);
+		}
+
+		BoundingSphere bounds;
+		std::vector<glm::vec3> points(vertices->size());
+		for (size_t i = 0; i < vertices->size(); ++i)
+			points[i] = glm::vec3((*vertices)[i].position);
+		bounds.fit(points);
+		std::vector<glm::vec3>().swap(points);
+
+		// simplified levels follow the full mesh in the index buffer
+		auto lods = std::make_shared<std::vector<MeshLevelOfDetail>>();
+		if (indices->empty() == false)
+			buildLevelsOfDetail(*vertices, *indices, bounds.radius, options.optimize, *lods);
+
+		// quantise last, once nothing else needs the full vertices
+		unsigned int vertexCount = (unsigned int)vertices->size();
+		std::shared_ptr<const void> vertexData(vertices, vertices->data());
+		glm::vec3 positionOffset(0);
+		glm::vec3 positionScale(1);
+		if (format == PACKED_VERTEX) {
+			auto packed = std::make_shared<std::vector<PackedVertex>>(vertexCount);
+			packVertices(vertices->data(), vertexCount, packed->data(), positionOffset, positionScale);
+			vertexData = std::shared_ptr<const void>(packed, packed->data());
+			vertices.reset();
+		}
+
+		// narrow the indices when the chunk is small enough
+		unsigned int indexCount = (unsigned int)indices->size();
+		unsigned int chunkIndexSize = indexSize(vertexCount);
+		std::shared_ptr<const void> indexData(indices, indices->data());
+		if (chunkIndexSize == sizeof(unsigned short)) {
+			auto shortIndices = std::make_shared<std::vector<unsigned short>>(indices->begin(), indices->end());
+			indexData = std::shared_ptr<const void>(shortIndices, shortIndices->data());
+			indices.reset();
+		}
+
+		// set chunk material
+		int materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
+
+		cache.writeChunk(vertexData.get(), vertexCount, indexData.get(), indexCount, chunkIndexSize,
+						 materialID, positionOffset, positionScale, bounds, *clusters, *lods);
+
+		// held by the upload so the chunk counts as queued until it is freed
+		std::shared_ptr<void> reservation;
+		if (limit != nullptr)
+			reservation = limit->reserve((size_t)vertexCount * vertexSize(format) + (size_t)indexCount * chunkIndexSize +
+										 clusters->size() * sizeof(MeshCluster) + lods->size() * sizeof(MeshLevelOfDetail));
+
+		upload([this, format, vertexData, vertexCount, indexData, indexCount, chunkIndexSize, materialID, positionOffset, positionScale, bounds, clusters, lods, reservation]() {
+			createChunk(format, vertexData.get(), vertexCount,
+						indexData.get(), indexCount, chunkIndexSize, materialID,
+						positionOffset, positionScale, bounds,
+						clusters->data(), (unsigned int)clusters->size(),
+						lods->data(), (unsigned int)lods->size());
+		});
+
+		s = tinyobj::shape_t();
+	};
+
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::vector<std::string> materialFiles;
+	std::string error = "";
+	bool success = false;
+
+	if (options.streaming) {
+		// chunks are created while the file is still being read
+		success = tinyobj::LoadObjStreaming(addShape, materials, error,
+											filename.c_str(), folder.c_str(), true, &materialFiles);
+	}
+	else {
+		success = tinyobj::LoadObj(shapes, materials, error,
+								   filename.c_str(), folder.c_str(), true, 0, &materialFiles);
+	}
+
+	if (success == false) {
+		printf("%s\n", error.c_str());
+		upload([this]() { destroyChunks(); });
+		return false;
+	}
+
+	// copy materials
+	auto meshMaterials = std::make_shared<std::vector<Material>>(materials.size());
+	std::vector<CacheMaterial> materialRecords(materials.size());
+	std::vector<std::string> materialTextureNames(materials.size() * TEXTURE_SLOT_COUNT);
+	int index = 0;
+	for (auto& m : materials) {
+
+		Material& material = (*meshMaterials)[index];
+		material.ambient = glm::vec3(m.ambient[0], m.ambient[1], m.ambient[2]);
+		material.diffuse = glm::vec3(m.diffuse[0], m.diffuse[1], m.diffuse[2]);
+		material.specular = glm::vec3(m.specular[0], m.specular[1], m.specular[2]);
+		material.emissive = glm::vec3(m.emission[0], m.emission[1], m.emission[2]);
+		material.specularPower = m.shininess;
+		material.opacity = m.dissolve;
+
+		// textures
+		std::string* textureNames = &materialTextureNames[index * TEXTURE_SLOT_COUNT];
+		textureNames[0] = m.diffuse_texname;
+		textureNames[1] = m.alpha_texname;
+		textureNames[2] = m.ambient_texname;
+		textureNames[3] = m.specular_texname;
+		textureNames[4] = m.specular_highlight_texname;
+		textureNames[5] = m.bump_texname;
+		textureNames[6] = m.displacement_texname;
+
+		CacheMaterial& record = materialRecords[index];
+		memcpy(record.ambient, m.ambient, sizeof(float) * 3);
+		memcpy(record.diffuse, m.diffuse, sizeof(float) * 3);
+		memcpy(record.specular, m.specular, sizeof(float) * 3);
+		memcpy(record.emissive, m.emission, sizeof(float) * 3);
+		record.specularPower = m.shininess;
+		record.opacity = m.dissolve;
+
+		++index;
+	}
+
+	if (options.loadTextures)
+		decodeMaterialTextures(*meshMaterials, folder, materialTextureNames.data());
+	uploadMaterials(meshMaterials, upload);
+
+	// copy shapes
+	if (options.streaming == false) {
+		size_t chunkCount = shapes.size();
+		upload([this, chunkCount]() { m_meshChunks.reserve(chunkCount); });
+		for (auto& s : shapes)
+			addShape(s);
+	}
+
+	if (before.triangleCount > 0) {
+		printf("%s vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", filename.c_str(),
+			   (float)before.transformedCount / before.triangleCount, (float)after.transformedCount / after.triangleCount,
+			   (float)before.transformedCount / before.vertexCount, (float)after.transformedCount / after.vertexCount);
+	}
+
+	// materials follow the chunks in the cache
+	for (size_t i = 0; i < materialRecords.size(); ++i)
+		cache.writeMaterial(materialRecords[i], &materialTextureNames[i * TEXTURE_SLOT_COUNT]);
+
+	for (auto& materialFile : materialFiles) {
+		unsigned long long size = 0;
+		long long time = 0;
+		getMaterialFileStamp(folder + materialFile, size, time);
+		cache.writeMaterialFile(materialFile, size, time);
+	}
+
+	if (options.useCache)
+		cache.end();
+
+	return true;
+}
+
+bool OBJMesh::loadCache(const std::string& filename, const std::string& folder, VertexFormat format, const LoadOptions& options, const Uploader& upload) {
+
+	unsigned long long sourceSize = 0;
+	long long sourceTime = 0;
+	if (getSourceStamp(filename.c_str(), sourceSize, sourceTime) == false)
+		return false;
+
+	// kept open until the last chunk has been uploaded from it
+	auto cacheFile = std::make_shared<MappedFile>();
+	if (cacheFile->open((filename + CACHE_EXTENSION).c_str()) == false)
+		return false;
+
+	const unsigned char* data = cacheFile->getData();
+	const unsigned char* dataEnd = data + cacheFile->getSize();
+
+	// walk the records, making sure the cache is complete before creating anything
+	// sizes are worked out in 64 bits so a corrupt count can't wrap around to
+	// something that fits
+	auto take = [&](unsigned long long size) -> const unsigned char* {
+		if ((unsigned long long)(dataEnd - data) < size)
+			return nullptr;
+		const unsigned char* record = data;
+		data += size;
+		return record;
+	};
+
+	auto header = (const CacheHeader*)take(sizeof(CacheHeader));
+	if (header == nullptr ||
+		memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		header->version != CACHE_VERSION ||
+		header->vertexSize != vertexSize(format) ||
+		header->flags != cacheFlags(format, options.flipTextureV, options.optimize) ||
+		header->sourceSize != sourceSize ||
+		header->sourceTime != sourceTime ||
+		header->materialCount > cacheFile->getSize() / sizeof(CacheMaterial) ||
+		header->chunkCount > cacheFile->getSize() / sizeof(CacheChunk))
+		return false;
+
+	std::vector<const CacheChunk*> chunks(header->chunkCount);
+	auto clusters = std::make_shared<std::vector<MeshCluster>>();
+	auto lods = std::make_shared<std::vector<MeshLevelOfDetail>>();
+	for (unsigned int i = 0; i < header->chunkCount; ++i) {
+		chunks[i] = (const CacheChunk*)take(sizeof(CacheChunk));
+		if (chunks[i] == nullptr)
+			return false;
+
+		unsigned long long vertexBytes = (unsigned long long)chunks[i]->vertexCount * vertexSize(format);
+		unsigned long long indexBytes = (unsigned long long)chunks[i]->indexCount * chunks[i]->indexSize;
+		if (chunks[i]->materialID >= (int)header->materialCount ||
+			chunks[i]->indexSize != indexSize(chunks[i]->vertexCount) ||
+			take(vertexBytes) == nullptr ||
+			take(indexBytes + cachePadding((size_t)indexBytes)) == nullptr)
+			return false;
+
+		// clusters are checked against the full detail level once it is known
+		size_t chunkClusters = clusters->size();
+		for (unsigned int j = 0; j < chunks[i]->clusterCount; ++j) {
+			auto record = (const CacheCluster*)take(sizeof(CacheCluster));
+			if (record == nullptr)
+				return false;
+
+			MeshCluster cluster;
+			cluster.firstIndex = record->firstIndex;
+			cluster.indexCount = record->indexCount;
+			cluster.bounds.centre = glm::vec3(record->centre[0], record->centre[1], record->centre[2]);
+			cluster.bounds.radius = record->radius;
+			cluster.coneAxis = glm::vec3(record->coneAxis[0], record->coneAxis[1], record->coneAxis[2]);
+			cluster.coneCutoff = record->coneCutoff;
+			clusters->push_back(cluster);
+		}
+
+		// the levels follow one another through every index of the chunk, so the
+		// first is the full mesh that a plain draw and the clusters use
+		unsigned long long fullCount = 0;
+		unsigned long long lodEnd = 0;
+		for (unsigned int j = 0; j < chunks[i]->lodCount; ++j) {
+			auto record = (const CacheLOD*)take(sizeof(CacheLOD));
+			if (record == nullptr ||
+				record->firstIndex != lodEnd)
+				return false;
+
+			if (j == 0)
+				fullCount = record->indexCount;
+			lodEnd += record->indexCount;
+
+			MeshLevelOfDetail lod = { record->firstIndex, record->indexCount, record->error };
+			lods->push_back(lod);
+		}
+
+		if (lodEnd != chunks[i]->indexCount)
+			return false;
+
+		for (size_t j = chunkClusters; j < clusters->size(); ++j)
+			if ((unsigned long long)(*clusters)[j].firstIndex + (*clusters)[j].indexCount > fullCount)
+				return false;
+	}
+
+	std::vector<const CacheMaterial*> materials(header->materialCount);
+	std::vector<std::string> textureNames(header->materialCount * TEXTURE_SLOT_COUNT);
+	for (unsigned int i = 0; i < header->materialCount; ++i) {
+		materials[i] = (const CacheMaterial*)take(sizeof(CacheMaterial));
+		if (materials[i] == nullptr)
+			return false;
+
+		for (unsigned int j = 0; j < TEXTURE_SLOT_COUNT; ++j) {
+			size_t length = materials[i]->textureNameLength[j];
+			auto name = (const char*)take(length + cachePadding(length));
+			if (name == nullptr)
+				return false;
+			textureNames[i * TEXTURE_SLOT_COUNT + j].assign(name, length);
+		}
+	}
+
+	// stale if any mtl file has changed since the cache was written
+	for (unsigned int i = 0; i < header->materialFileCount; ++i) {
+		auto record = (const CacheMaterialFile*)take(sizeof(CacheMaterialFile));
+		if (record == nullptr)
+			return false;
+
+		size_t length = record->nameLength;
+		auto name = (const char*)take(length + cachePadding(length));
+		if (name == nullptr)
+			return false;
+
+		unsigned long long size = 0;
+		long long time = 0;
+		getMaterialFileStamp(folder + std::string(name, length), size, time);
+		if (size != record->size ||
+			time != record->time)
+			return false;
+	}
+
+	// copy materials
+	auto meshMaterials = std::make_shared<std::vector<Material>>(header->materialCount);
+	for (unsigned int i = 0; i < header->materialCount; ++i) {
+		const CacheMaterial& m = *materials[i];
+		Material& material = (*meshMaterials)[i];
+
+		material.ambient = glm::vec3(m.ambient[0], m.ambient[1], m.ambient[2]);
+		material.diffuse = glm::vec3(m.diffuse[0], m.diffuse[1], m.diffuse[2]);
+		material.specular = glm::vec3(m.specular[0], m.specular[1], m.specular[2]);
+		material.emissive = glm::vec3(m.emissive[0], m.emissive[1], m.emissive[2]);
+		material.specularPower = m.specularPower;
+		material.opacity = m.opacity;
+	}
+
+	if (options.loadTextures)
+		decodeMaterialTextures(*meshMaterials, folder, textureNames.data());
+	uploadMaterials(meshMaterials, upload);
+
+	// upload chunks directly from the mapped file
+	unsigned int chunkCount = header->chunkCount;
+	upload([this, chunkCount]() { m_meshChunks.reserve(chunkCount); });
+	unsigned int firstCluster = 0;
+	unsigned int firstLOD = 0;
+	for (auto c : chunks) {
+		upload([this, cacheFile, c, format, clusters, firstCluster, lods, firstLOD]() {
+			auto vertices = (const unsigned char*)(c + 1);
+			auto indices = vertices + c->vertexCount * vertexSize(format);
+
+			BoundingSphere bounds;
+			bounds.centre = glm::vec3(c->centre[0], c->centre[1], c->centre[2]);
+			bounds.radius = c->radius;
+
+			createChunk(format, vertices, c->vertexCount, indices, c->indexCount, c->indexSize, c->materialID,
+						glm::vec3(c->positionOffset[0], c->positionOffset[1], c->positionOffset[2]),
+						glm::vec3(c->positionScale[0], c->positionScale[1], c->positionScale[2]), bounds,
+						clusters->data() + firstCluster, c->clusterCount,
+						lods->data() + firstLOD, c->lodCount);
+		});
+		firstCluster += c->clusterCount;
+		firstLOD += c->lodCount;
+	}
+
+	return true;
+}
+
+void OBJMesh::decodeMaterialTextures(std::vector<Material>& materials, const std::string& folder, const std::string* textureNames) {
+
+	// decode every texture of the mesh at once, remembering which slot each fills
+	TextureBatch batch;
+	std::vector<size_t> images(materials.size() * TEXTURE_SLOT_COUNT);
+	for (size_t i = 0; i < images.size(); ++i)
+		if (textureNames[i].empty() == false)
+			images[i] = batch.add(folder + textureNames[i]);
+
+	if (batch.getCount() == 0)
+		return;
+
+	batch.wait();
+
+	for (size_t i = 0; i < images.size(); ++i)
+		if (textureNames[i].empty() == false)
+			materials[i / TEXTURE_SLOT_COUNT].*TEXTURE_SLOTS[i % TEXTURE_SLOT_COUNT] = batch.getTexture(images[i]);
+
+	batch.printDecodeTimes();
+}
+
+void OBJMesh::uploadMaterials(const std::shared_ptr<std::vector<Material>>& materials, const Uploader& upload) {
+
+	// find the decoded textures before the materials are handed over, once
+	// each even when materials share them
+	std::vector<std::shared_ptr<Texture>> textures;
+	for (auto& material : *materials)
+		for (unsigned int j = 0; j < TEXTURE_SLOT_COUNT; ++j)
+			if (material.*TEXTURE_SLOTS[j] != nullptr &&
+				std::find(textures.begin(), textures.end(), material.*TEXTURE_SLOTS[j]) == textures.end())
+				textures.push_back(material.*TEXTURE_SLOTS[j]);
+
+	upload([this, materials]() {
+		m_materials.swap(*materials);
+		updateMaterialBuffer();
+	});
+
+	// each texture is its own upload to keep them within a frame budget, those
+	// another mesh already uploaded through the cache are skipped
+	for (auto& texture : textures) {
+		upload([texture]() {
+			if (texture->getHandle() == 0)
+				texture->upload();
+		});
+	}
+}
+
+void OBJMesh::updateMaterialBuffer() {
+
+	// each material is bound on its own, so has to start on the alignment
+	int alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, 1);
+	m_materialStride = (unsigned int)((sizeof(MaterialBlock) + alignment - 1) / alignment * alignment);
+
+	// the default material has the slot after the mesh's own
+	std::vector<unsigned char> data((m_materials.size() + 1) * m_materialStride);
+	for (size_t i = 0; i <= m_materials.size(); ++i) {
+		const Material& material = getSlotMaterial((unsigned int)i);
+
+		MaterialBlock block = {};
+		memcpy(block.ambient, &material.ambient[0], sizeof(float) * 3);
+		memcpy(block.diffuse, &material.diffuse[0], sizeof(float) * 3);
+		memcpy(block.specular, &material.specular[0], sizeof(float) * 3);
+		memcpy(block.emissive, &material.emissive[0], sizeof(float) * 3);
+		block.opacity = material.opacity;
+		block.specularPower = material.specularPower;
+		memcpy(&data[i * m_materialStride], &block, sizeof(MaterialBlock));
+	}
+
+	if (m_materialBuffer == 0)
+		glGenBuffers(1, &m_materialBuffer);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+unsigned int OBJMesh::getMaterialSlot(int materialID) const {
+	if (materialID < 0 ||
+		materialID >= (int)m_materials.size())
+		return (unsigned int)m_materials.size();
+	return (unsigned int)materialID;
+}
+
+const OBJMesh::Material& OBJMesh::getSlotMaterial(unsigned int slot) const {
+	return slot < m_materials.size() ? m_materials[slot] : DEFAULT_MATERIAL;
+}
+
+void OBJMesh::createChunk(VertexFormat format, const void* vertices, unsigned int vertexCount,
+						  const void* indices, unsigned int indexCount, unsigned int indexSize, int materialID,
+						  const glm::vec3& positionOffset, const glm::vec3& positionScale, const BoundingSphere& bounds,
+						  const MeshCluster* clusters, unsigned int clusterCount,
+						  const MeshLevelOfDetail* lods, unsigned int lodCount) {
+
+	MeshChunk chunk;
+
+	// copy in to the arena shared by every mesh with this vertex format, the
+	// packed position bounds go in the chunk's record
+	GeometryArena::ChunkRecord record;
+	memcpy(record.positionOffset, &positionOffset[0], sizeof(float) * 3);
+	memcpy(record.positionScale, &positionScale[0], sizeof(float) * 3);
+	chunk.allocation = getArena(format).allocate(vertices, vertexCount, indices, indexCount, indexSize, record);
+
+	// store index count and type for rendering, a plain draw only uses the full detail level
+	chunk.indexCount = lodCount > 0 ? lods[0].indexCount : indexCount;
+	chunk.indexType = indexType(indexSize);
+
+	// set chunk material
+	chunk.materialID = materialID;
+
+	chunk.bounds = bounds;
+
+	chunk.firstCluster = (unsigned int)m_clusters.size();
+	chunk.clusterCount = clusterCount;
+	m_clusters.insert(m_clusters.end(), clusters, clusters + clusterCount);
+
+	chunk.firstLOD = (unsigned int)m_lods.size();
+	chunk.lodCount = lodCount;
+	m_lods.insert(m_lods.end(), lods, lods + lodCount);
+
+	// the whole mesh's bounds grow to take in each chunk
+	if (m_meshChunks.empty())
+		m_bounds = bounds;
+	else
+		m_bounds.merge(bounds);
+
+	// kept in material order, so a draw finds each material's chunks together
+	// without having to sort them
+	// chunks without a material compare as unsigned to go last, like their slot
+	auto position = std::upper_bound(m_meshChunks.begin(), m_meshChunks.end(), chunk, [](const MeshChunk& a, const MeshChunk& b) {
+		if (a.materialID != b.materialID)
+			return (unsigned int)a.materialID < (unsigned int)b.materialID;
+		return a.indexType < b.indexType;
+	});
+	m_meshChunks.insert(position, chunk);
+}
+
+void OBJMesh::destroyChunks() {
+	for (auto& c : m_meshChunks)
+		getArena(m_vertexFormat).free(c.allocation);
+	m_meshChunks.clear();
+	m_bounds = BoundingSphere();
+	m_clusters.clear();
+	m_lods.clear();
+}
+
+OBJMesh::DrawStats OBJMesh::s_drawStats = {};
+
+void OBJMesh::draw(bool usePatches /* = false */) {
+	drawChunks(usePatches, nullptr, 1);
+}
+
+void OBJMesh::drawInstanced(const glm::mat4* modelMatrices, size_t instanceCount, bool usePatches /* = false */) {
+
+	if (instanceCount == 0)
+		return;
+
+	if (m_instanceBuffer == 0)
+		glGenBuffers(1, &m_instanceBuffer);
+
+	// orphaned each time so earlier draws can still be reading the last transforms
+	GLsizeiptr size = (GLsizeiptr)(instanceCount * sizeof(InstanceTransform));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	auto instances = (InstanceTransform*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size,
+														   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (instances == nullptr) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		return;
+	}
+
+	// the normal matrices are worked out on the pool, straight in to the mapped buffer
+	unsigned int jobCount = (unsigned int)((instanceCount + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB);
+	ThreadPool::get().parallelFor(jobCount, [&](unsigned int job) {
+		size_t first = (size_t)job * INSTANCES_PER_JOB;
+		size_t last = std::min(first + INSTANCES_PER_JOB, instanceCount);
+		for (size_t i = first; i < last; ++i) {
+			instances[i].model = modelMatrices[i];
+			instances[i].normal = glm::mat4(glm::inverseTranspose(glm::mat3(modelMatrices[i])));
+		}
+	});
+
+	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BLOCK_BINDING, m_instanceBuffer);
+
+	drawChunks(usePatches, nullptr, (unsigned int)instanceCount);
+}
+
+void OBJMesh::draw(const glm::mat4& modelMatrix, const glm::mat4& projectionView,
+				   const glm::vec3& cameraPosition, bool usePatches /* = false */) {
+
+	// cull in model space so the clusters don't need transforming
+	DrawView view;
+	view.frustum.set(projectionView * modelMatrix);
+	view.cameraPosition = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(cameraPosition, 1));
+	view.cullBackFacing = true;
+	view.pixelScale = 0;
+	view.perspective = true;
+	view.maxPixelError = 0;
+
+	drawChunks(usePatches, &view, 1);
+}
+
+void OBJMesh::draw(const glm::mat4& modelMatrix, const glm::mat4& projectionView, bool usePatches /* = false */) {
+
+	glm::mat4 projectionViewModel = projectionView * modelMatrix;
+
+	DrawView view;
+	view.frustum.set(projectionViewModel);
+	view.pixelScale = 0;
+	view.perspective = true;
+	view.maxPixelError = 0;
+
+	// the camera is the point that projects to x = y = w = 0, which an
+	// orthographic projection leaves at infinity
+	glm::vec4 camera = glm::inverse(projectionViewModel) * glm::vec4(0, 0, 1, 0);
+	view.cullBackFacing = glm::abs(camera.w) > 1e-6f;
+	view.cameraPosition = view.cullBackFacing ? glm::vec3(camera) / camera.w : glm::vec3(0);
+
+	drawChunks(usePatches, &view, 1);
+}
+
+void OBJMesh::drawLOD(const glm::mat4& modelMatrix, const glm::mat4& projection, const glm::mat4& view,
+					  float viewportHeight, float maxPixelError /* = 1.0f */, bool usePatches /* = false */) {
+
+	glm::mat4 modelView = view * modelMatrix;
+
+	DrawView drawView;
+	drawView.frustum.set(projection * modelView);
+	drawView.cameraPosition = glm::vec3(glm::inverse(modelView)[3]);
+	drawView.cullBackFacing = true;
+	drawView.maxPixelError = maxPixelError;
+
+	// a perspective projection divides by view depth, which is kept in w
+	drawView.perspective = projection[2][3] != 0;
+	drawView.pixelScale = projection[1][1] * viewportHeight * 0.5f;
+
+	// distances are measured in model space, which cancels out any scale when
+	// dividing by them, but an orthographic projection never divides
+	if (drawView.perspective == false)
+		drawView.pixelScale *= glm::length(glm::vec3(modelView[1]));
+
+	drawChunks(usePatches, &drawView, 1);
+}
+
+void OBJMesh::drawChunks(bool usePatches, const DrawView* view, unsigned int instanceCount) {
+
+	int program = -1;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+	if (program == -1) {
+		printf("No shader bound!\n");
+		return;
+	}
+
+	MaterialUniforms& uniforms = getMaterialUniforms(program);
+
+	// tell the shader how to decode the vertices
+	int packed = m_vertexFormat == PACKED_VERTEX;
+	if (uniforms.packedVertices >= 0 &&
+		uniforms.packedValue != packed) {
+		glUniform1i(uniforms.packedVertices, packed);
+		uniforms.packedValue = packed;
+	}
+
+	// find what to draw of every chunk before any gl calls
+	m_chunkCommands.clear();
+	auto gatherChunk = [&](const MeshChunk& c) {
+
+		// level and cluster indices are relative to the chunk
+		ChunkCommand chunkCommand;
+		chunkCommand.materialSlot = getMaterialSlot(c.materialID);
+		chunkCommand.indexType = c.indexType;
+		chunkCommand.command.instanceCount = instanceCount;
+		chunkCommand.command.baseVertex = c.allocation.baseVertex;
+		chunkCommand.command.baseInstance = c.allocation.record;
+
+		size_t firstCommand = m_chunkCommands.size();
+		auto addRange = [&](unsigned int firstIndex, unsigned int indexCount) {
+			// neighbouring ranges merge in to one
+			if (m_chunkCommands.size() > firstCommand) {
+				GeometryArena::DrawCommand& last = m_chunkCommands.back().command;
+				if (last.firstIndex + last.count == c.allocation.firstIndex + firstIndex) {
+					last.count += indexCount;
+					return;
+				}
+			}
+
+			chunkCommand.command.firstIndex = c.allocation.firstIndex + firstIndex;
+			chunkCommand.command.count = indexCount;
+			m_chunkCommands.push_back(chunkCommand);
+		};
+
+		if (view == nullptr) {
+			addRange(0, c.indexCount);
+			return;
+		}
+
+		if (view->frustum.intersects(c.bounds.centre, c.bounds.radius) == false)
+			return;
+
+		// the simplest level whose error covers few enough pixels, the camera
+		// being inside the bounds always gets full detail
+		unsigned int level = 0;
+		if (view->pixelScale > 0) {
+			float distance = 1;
+			if (view->perspective)
+				distance = glm::length(c.bounds.centre - view->cameraPosition) - c.bounds.radius;
+
+			while (distance > 0 &&
+				   level + 1 < c.lodCount &&
+				   m_lods[c.firstLOD + level + 1].error * view->pixelScale <= view->maxPixelError * distance)
+				++level;
+		}
+
+		if (level > 0) {
+			const MeshLevelOfDetail& lod = m_lods[c.firstLOD + level];
+			addRange(lod.firstIndex, lod.indexCount);
+			return;
+		}
+
+		// only the visible clusters of the full detail level
+		for (unsigned int i = c.firstCluster; i < c.firstCluster + c.clusterCount; ++i) {
+			const MeshCluster& cluster = m_clusters[i];
+			if (view->frustum.intersects(cluster.bounds.centre, cluster.bounds.radius) &&
+				(view->cullBackFacing == false || cluster.isBackFacing(view->cameraPosition) == false))
+				addRange(cluster.firstIndex, cluster.indexCount);
+		}
+	};
+
+	// a mesh entirely outside the frustum skips every chunk's tests
+	if (view != nullptr &&
+		view->frustum.intersects(m_bounds.centre, m_bounds.radius) == false) {
+		s_drawStats.chunksCulled += (unsigned int)m_meshChunks.size();
+		return;
+	}
+
+	for (auto& c : m_meshChunks) {
+		size_t firstCommand = m_chunkCommands.size();
+		gatherChunk(c);
+
+		if (m_chunkCommands.size() > firstCommand)
+			++s_drawStats.chunksDrawn;
+		else
+			++s_drawStats.chunksCulled;
+	}
+
+	if (m_chunkCommands.empty())
+		return;
+
+	// group the commands by material and index type so each group is a single
+	// multi-draw, the chunks are kept in that order so this rarely has to sort
+	// and the stable sort keeps each chunk's ranges in their optimized order
+	auto commandLess = [](const ChunkCommand& a, const ChunkCommand& b) {
+		if (a.materialSlot != b.materialSlot)
+			return a.materialSlot < b.materialSlot;
+		return a.indexType < b.indexType;
+	};
+	if (std::is_sorted(m_chunkCommands.begin(), m_chunkCommands.end(), commandLess) == false)
+		std::stable_sort(m_chunkCommands.begin(), m_chunkCommands.end(), commandLess);
+
+	m_drawCommands.resize(m_chunkCommands.size());
+	for (size_t i = 0; i < m_chunkCommands.size(); ++i)
+		m_drawCommands[i] = m_chunkCommands[i].command;
+
+	getArena(m_vertexFormat).bind(m_drawCommands.data(), m_drawCommands.size(), instanceCount);
+
+	unsigned int mode = usePatches ? GL_PATCHES : GL_TRIANGLES;
+	unsigned int currentSlot = 0;
+	for (size_t first = 0; first < m_chunkCommands.size();) {
+		unsigned int slot = m_chunkCommands[first].materialSlot;
+		unsigned int type = m_chunkCommands[first].indexType;
+
+		size_t last = first + 1;
+		while (last < m_chunkCommands.size() &&
+			   m_chunkCommands[last].materialSlot == slot &&
+			   m_chunkCommands[last].indexType == type)
+			++last;
+
+		// bind material
+		if (first == 0 ||
+			currentSlot != slot) {
+			currentSlot = slot;
+			++s_drawStats.materialSwitches;
+
+			const Material& material = getSlotMaterial(currentSlot);
+			if (uniforms.materialBlock >= 0 &&
+				m_materialBuffer != 0) {
+				glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialBuffer,
+								  (GLintptr)currentSlot * m_materialStride, sizeof(MaterialBlock));
+			}
+			else {
+				if (uniforms.ka >= 0)
+					glUniform3fv(uniforms.ka, 1, &material.ambient[0]);
+				if (uniforms.kd >= 0)
+					glUniform3fv(uniforms.kd, 1, &material.diffuse[0]);
+				if (uniforms.ks >= 0)
+					glUniform3fv(uniforms.ks, 1, &material.specular[0]);
+				if (uniforms.ke >= 0)
+					glUniform3fv(uniforms.ke, 1, &material.emissive[0]);
+				if (uniforms.opacity >= 0)
+					glUniform1f(uniforms.opacity, material.opacity);
+				if (uniforms.specularPower >= 0)
+					glUniform1f(uniforms.specularPower, material.specularPower);
+			}
+
+			for (unsigned int i = 0; i < TEXTURE_SLOT_COUNT; ++i) {
+				unsigned int handle = textureHandle(material.*TEXTURE_SLOTS[i]);
+				glActiveTexture(GL_TEXTURE0 + i);
+				if (handle > 0)
+					glBindTexture(GL_TEXTURE_2D, handle);
+				else if (uniforms.textures[i] >= 0)
+					glBindTexture(GL_TEXTURE_2D, 0);
+			}
+		}
+
+		// draw every range with the material in one call
+		glMultiDrawElementsIndirect(mode, type, (const void*)(first * sizeof(GeometryArena::DrawCommand)),
+									(int)(last - first), 0);
+		first = last;
+	}
+
+	// bind 0 for safety
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+	calculateTangents(vertices.data(), (unsigned int)vertices.size(),
+					  indices.data(), (unsigned int)indices.size());
+}
+
+void OBJMesh::calculateTangents(Vertex* vertices, unsigned int vertexCount,
+								const unsigned int* indices, unsigned int indexCount) {
+
+	if (vertexCount == 0)
+		return;
+
+	ThreadPool& pool = ThreadPool::get();
+
+	// triangles are split between jobs that each sum in to their own copy of the
+	// accumulators, so no atomics are needed
+	unsigned int triangleCount = indexCount / 3;
+	unsigned int sumCount = triangleCount / TANGENT_MIN_TRIANGLES_PER_JOB;
+	if (sumCount > pool.getThreadCount())
+		sumCount = pool.getThreadCount();
+	if (sumCount < 1)
+		sumCount = 1;
+
+	std::unique_ptr<TangentSum[]> sums(new TangentSum[(size_t)vertexCount * sumCount]);
+
+	pool.parallelFor(sumCount, [&](unsigned int job) {
+		TangentSum* jobSums = sums.get() + (size_t)vertexCount * job;
+		memset(jobSums, 0, vertexCount * sizeof(TangentSum));
+
+		unsigned int first = (unsigned int)((unsigned long long)triangleCount * job / sumCount);
+		unsigned int last = (unsigned int)((unsigned long long)triangleCount * (job + 1) / sumCount);
+		accumulateTangents(vertices, indices, first * 3, last * 3, jobSums);
+	});
+
+	// then the vertices are split between jobs that combine the sums and
+	// orthogonalize, in blocks of 4 for the simd path
+	unsigned int blockCount = (vertexCount + 3) / 4;
+	unsigned int vertexJobs = blockCount / TANGENT_MIN_BLOCKS_PER_JOB;
+	if (vertexJobs > pool.getThreadCount())
+		vertexJobs = pool.getThreadCount();
+	if (vertexJobs < 1)
+		vertexJobs = 1;
+
+	pool.parallelFor(vertexJobs, [&](unsigned int job) {
+		unsigned int first = (unsigned int)((unsigned long long)blockCount * job / vertexJobs) * 4;
+		unsigned int last = (unsigned int)((unsigned long long)blockCount * (job + 1) / vertexJobs) * 4;
+		if (last > vertexCount)
+			last = vertexCount;
+		orthogonalizeTangents(vertices, first, last, sums.get(), vertexCount, sumCount);
+	});
+}
+
 }
\ No newline at end of file
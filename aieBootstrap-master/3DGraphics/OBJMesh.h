@@ -3,9 +3,17 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 #include "Texture.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "MeshOptimizer.h"
 
 namespace aie {
 
@@ -23,6 +31,21 @@ public:
 		glm::vec4 tangent;	// added to attrib location 3
 	};
 
+	// a quantised vertex, around a third of the size of Vertex
+	// the phong vertex shader decodes it when PackedVertices is set
+	struct PackedVertex {
+		unsigned short	position[4];	// xyz normalised to the chunk bounds, w is the tangent handedness (0 for -1)
+		short			normal[2];		// octahedral encoded
+		short			tangent[2];		// octahedral encoded
+		unsigned short	texcoord[2];	// half floats
+	};
+
+	// the vertex layouts a mesh can be uploaded with
+	enum VertexFormat : unsigned int {
+		FULL_VERTEX = 0,	// Vertex
+		PACKED_VERTEX,		// PackedVertex
+	};
+
 	// a basic material
 	class Material {
 	public:
@@ -38,24 +61,104 @@ public:
 		float specularPower;
 		float opacity;
 
-		Texture diffuseTexture;				// bound slot 0
-		Texture alphaTexture;				// bound slot 1
-		Texture ambientTexture;				// bound slot 2
-		Texture specularTexture;			// bound slot 3
-		Texture specularHighlightTexture;	// bound slot 4
-		Texture normalTexture;				// bound slot 5
-		Texture displacementTexture;		// bound slot 6
+		// shared through the TextureCache, null when the material has none
+		std::shared_ptr<Texture> diffuseTexture;			// bound slot 0
+		std::shared_ptr<Texture> alphaTexture;				// bound slot 1
+		std::shared_ptr<Texture> ambientTexture;			// bound slot 2
+		std::shared_ptr<Texture> specularTexture;			// bound slot 3
+		std::shared_ptr<Texture> specularHighlightTexture;	// bound slot 4
+		std::shared_ptr<Texture> normalTexture;				// bound slot 5
+		std::shared_ptr<Texture> displacementTexture;		// bound slot 6
 	};
 
-	OBJMesh() {}
+	OBJMesh() : m_vertexFormat(FULL_VERTEX), m_materialBuffer(0), m_materialStride(0), m_instanceBuffer(0), m_loading(false) {}
 	~OBJMesh();
 
+	// how a mesh is loaded, defaults to everything but streaming
+	// the processed mesh is written to a binary cache beside the obj the first
+	// time it loads, and later loads map the cache instead of parsing the obj
+	// streaming reads the obj a line at a time and uploads each group as soon as
+	// it is finished, keeping memory use to the largest group rather than the
+	// whole file, at the cost of parsing on a single thread
+	// optimize reorders each chunk's triangles for the post-transform vertex
+	// cache, and for overdraw when that costs little of the cache's reuse, and
+	// its vertices for fetching, printing the cache miss ratios before and after
+	// each chunk also gets up to 3 simplified levels of detail, see drawLOD()
+	struct LoadOptions {
+		bool	loadTextures;	// decode and upload the materials' textures
+		bool	flipTextureV;	// depends on how the mesh was made
+		bool	useCache;
+		bool	streaming;
+		bool	optimize;
+
+		LoadOptions() : loadTextures(true), flipTextureV(false), useCache(true), streaming(false), optimize(true) {}
+	};
+
 	// will fail if a mesh has already been loaded in to this instance
-	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false);
+	bool load(const char* filename, const LoadOptions& options = LoadOptions());
+
+	// loads on the shared ThreadPool, the obj or cache is read, processed and its
+	// textures decoded off the calling thread, while buffer and texture creation
+	// is queued on the UploadQueue for the thread that owns the opengl context
+	// chunks can be drawn as soon as they have been created, and the future is
+	// set once everything has been uploaded, so don't wait on it from the thread
+	// that processes the UploadQueue
+	// when streaming, parsing stops while more than a few tens of megabytes of
+	// chunks are waiting in the UploadQueue, so memory stays bounded however
+	// slowly the queue is drained
+	std::shared_future<bool> loadAsync(const char* filename, const LoadOptions& options = LoadOptions());
+
+	bool isLoading() const { return m_loading; }
 
+	// layout used for the vertex buffers, will fail once a mesh has been loaded
+	bool setVertexFormat(VertexFormat format);
+	VertexFormat getVertexFormat() const { return m_vertexFormat; }
+
+	// chunks live in a GeometryArena shared by every mesh with the same vertex
+	// format, and those with the same material and index type are drawn
+	// together in a single glMultiDrawElementsIndirect call
 	// allow option to draw as patches for tessellation
 	void draw(bool usePatches = false);
 
+	// draws only the clusters that are inside the frustum and not facing away
+	// from the camera, chunks with none left are skipped without any gl calls
+	// the shader's transforms still need to be bound
+	void draw(const glm::mat4& modelMatrix, const glm::mat4& projectionView,
+			  const glm::vec3& cameraPosition, bool usePatches = false);
+
+	// culls as above with the camera found from projectionView, facing away
+	// isn't tested when the projection is orthographic
+	void draw(const glm::mat4& modelMatrix, const glm::mat4& projectionView, bool usePatches = false);
+
+	// draws each chunk at the simplest level of detail that stays within
+	// maxPixelError pixels of the full mesh on screen, measured from the
+	// chunk's bounds, then culls as the draw above (clusters only exist for
+	// the full detail level)
+	// projection and view are the camera's, viewportHeight in pixels
+	void drawLOD(const glm::mat4& modelMatrix, const glm::mat4& projection, const glm::mat4& view,
+				 float viewportHeight, float maxPixelError = 1.0f, bool usePatches = false);
+
+	// draws every chunk once for each model matrix in a single call per material,
+	// for a program reading its transforms from an Instances block such as
+	// Phong.vert built with INSTANCED defined, with ProjectionView set rather
+	// than ProjectionViewModel
+	// the matrices and their normal matrices are streamed in to a buffer each call
+	void drawInstanced(const glm::mat4* modelMatrices, size_t instanceCount, bool usePatches = false);
+
+	// totals over every mesh's draws since the last reset, reset once a frame to
+	// get them per frame
+	struct DrawStats {
+		unsigned int	chunksDrawn;
+		unsigned int	chunksCulled;		// outside the frustum, or with no visible clusters
+		unsigned int	materialSwitches;	// each draw binds a material once however many chunks use it
+	};
+
+	static const DrawStats& getDrawStats() { return s_drawStats; }
+	static void resetDrawStats() { s_drawStats = DrawStats(); }
+
+	// model space bounds of every chunk, grown as they are created
+	const BoundingSphere& getBounds() const { return m_bounds; }
+
 	// access to the filename that was loaded
 	const std::string& getFilename() const { return m_filename; }
 
@@ -63,19 +166,123 @@ public:
 	size_t getMaterialCount() const { return m_materials.size();  }
 	Material& getMaterial(size_t index) { return m_materials[index];  }
 
+	// the colours of every material, and of a default one for chunks without
+	// a material, are kept in a uniform buffer that shaders with a std140
+	// Material block read from, call this after changing them through
+	// getMaterial() so the buffer matches
+	void updateMaterialBuffer();
+
+	// generates normal-mapping tangents (handedness in w) from the positions,
+	// normals and texcoords of an indexed triangle list, using the shared ThreadPool
+	static void calculateTangents(Vertex* vertices, unsigned int vertexCount,
+								  const unsigned int* indices, unsigned int indexCount);
+	static void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
 private:
 
-	void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+	// opengl work from a load, run straight away by load() or queued by loadAsync()
+	// nothing else in a load touches the mesh, so the rest can run on any thread
+	typedef std::function<void(std::function<void()>)> Uploader;
+
+	// counts the chunk data a streamed loadAsync() has waiting to be uploaded,
+	// and holds the loading thread back while there is too much of it
+	class UploadLimit;
+
+	// limit is null unless the chunks are queued for another thread
+	bool loadData(const std::string& filename, VertexFormat format, const LoadOptions& options, const Uploader& upload,
+				  const std::shared_ptr<UploadLimit>& limit);
+
+	// binary cache support
+	bool loadCache(const std::string& filename, const std::string& folder, VertexFormat format, const LoadOptions& options, const Uploader& upload);
+
+	// textureNames holds TEXTURE_SLOT_COUNT names for each material, all decoded together
+	static void decodeMaterialTextures(std::vector<Material>& materials, const std::string& folder, const std::string* textureNames);
+	void uploadMaterials(const std::shared_ptr<std::vector<Material>>& materials, const Uploader& upload);
+
+	// the slot in the material buffer a chunk's material is bound from, chunks
+	// without one, or with one the mesh doesn't have, get the default material
+	// in the slot after the mesh's own
+	unsigned int getMaterialSlot(int materialID) const;
+	const Material& getSlotMaterial(unsigned int slot) const;
+
+	// where a culled draw is seen from, all in model space
+	struct DrawView {
+		Frustum		frustum;
+		glm::vec3	cameraPosition;
+		bool		cullBackFacing;	// false to only cull clusters outside the frustum
+
+		// pixels covered by a unit of error, at a unit of distance when perspective
+		// 0 always draws full detail
+		float		pixelScale;
+		bool		perspective;
+		float		maxPixelError;
+	};
+
+	// view is null to draw everything at full detail
+	void drawChunks(bool usePatches, const DrawView* view, unsigned int instanceCount);
+
+	// vertices are either Vertex or PackedVertex depending on format, and
+	// indices are unsigned shorts or ints depending on indexSize
+	// indexCount covers every level of detail, the first level is the full mesh
+	void createChunk(VertexFormat format, const void* vertices, unsigned int vertexCount,
+					 const void* indices, unsigned int indexCount, unsigned int indexSize, int materialID,
+					 const glm::vec3& positionOffset, const glm::vec3& positionScale, const BoundingSphere& bounds,
+					 const MeshCluster* clusters, unsigned int clusterCount,
+					 const MeshLevelOfDetail* lods, unsigned int lodCount);
+	void destroyChunks();
 
 	struct MeshChunk {
-		unsigned int	vao, vbo, ibo;
+		GeometryArena::Allocation	allocation;
+
 		unsigned int	indexCount;
+		unsigned int	indexType;	// GL_UNSIGNED_SHORT when every vertex fits in 16 bits, else GL_UNSIGNED_INT
 		int				materialID;
+
+		// model space bounds of every vertex
+		BoundingSphere	bounds;
+
+		// range of m_clusters
+		unsigned int	firstCluster;
+		unsigned int	clusterCount;
+
+		// range of m_lods, full detail first
+		unsigned int	firstLOD;
+		unsigned int	lodCount;
+	};
+
+	VertexFormat				m_vertexFormat;
+	std::string					m_filename;
+	std::vector<MeshChunk>		m_meshChunks;
+	BoundingSphere				m_bounds;
+	std::vector<Material>		m_materials;
+
+	// one std140 Material block per material then the default one, each
+	// starting on the uniform buffer offset alignment
+	unsigned int				m_materialBuffer;
+	unsigned int				m_materialStride;
+
+	// transforms of the last instanced draw
+	unsigned int				m_instanceBuffer;
+	std::vector<MeshCluster>	m_clusters;
+	std::vector<MeshLevelOfDetail>	m_lods;
+
+	// visible index ranges of every chunk being drawn, tagged with what they
+	// are batched by
+	struct ChunkCommand {
+		unsigned int				materialSlot;	// see getMaterialSlot()
+		unsigned int				indexType;
+		GeometryArena::DrawCommand	command;
 	};
 
-	std::string				m_filename;
-	std::vector<MeshChunk>	m_meshChunks;
-	std::vector<Material>	m_materials;
+	std::vector<ChunkCommand>				m_chunkCommands;
+	std::vector<GeometryArena::DrawCommand>	m_drawCommands;
+
+	static DrawStats	s_drawStats;
+
+	// set when the mesh is destroyed so queued uploads for it are skipped
+	std::shared_ptr<std::atomic<bool>>	m_cancelLoad;
+	std::shared_ptr<UploadLimit>		m_uploadLimit;
+	bool								m_loading;
 };
 
 } // namespace aie
\ No newline at end of file
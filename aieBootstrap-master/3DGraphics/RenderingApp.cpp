@@ -82,7 +82,9 @@ bool RenderingApp::startup()
 	//					 0.0f, 0.0f, 0.5f, 0.0f,
 	//					 -0.08f, 0.0f, -0.07f, 1.0f };
 
-	if (m_spearMesh.load("../bin/soulspear/soulspear.obj", true, true) == false)
+	aie::OBJMesh::LoadOptions spearOptions;
+	spearOptions.flipTextureV = true;
+	if (m_spearMesh.load("../bin/soulspear/soulspear.obj", spearOptions) == false)
 	{
 		printf("Soulspear Mesh Error!\n");
 		return false;
@@ -99,13 +101,13 @@ bool RenderingApp::startup()
 	//m_light.position = glm::vec3(m_camera->GetModel()[3]);
 	//m_light.intensities = glm::vec3(1.0f);
 
-	Light pointLight;
+	aie::Light pointLight;
 	pointLight.position = glm::vec4(-4.0f, 0.0f, 10.0f, 1.0f);
 	pointLight.Ia = glm::vec3(0.25f);
 	pointLight.Id = glm::vec3(0.0f, 1.0f, 1.0f);
 	pointLight.Is = glm::vec3(0.0f, 1.0f, 1.0f);
 	pointLight.attenuation = 0.0f;
-	Light directionalLight;
+	aie::Light directionalLight;
 	directionalLight.position = glm::vec4(1.0f, 0.8f, 0.6f, 0.0f);
 	directionalLight.Ia = glm::vec3(0.25f);
 	directionalLight.Id = glm::vec3(1.0f, 1.0f, 0.0f);
@@ -186,17 +188,10 @@ void RenderingApp::draw()
 	m_phongShader.bindUniform("ProjectionViewModel", pvm * m_spearTransform);
 	m_phongShader.bindUniform("ModelMatrix", m_camera->GetModel());
 	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_spearTransform)));
-	m_phongShader.bindUniform("numLights", (int)m_lights.size());
 	m_phongShader.bindUniform("cameraPosition", glm::vec3(m_camera->GetModel()[3]));
 
-	for (size_t i = 0; i < m_lights.size(); i++)
-	{
-		SetLightUniform(&m_phongShader, "position", i, m_lights[i].position);
-		SetLightUniform(&m_phongShader, "Ia", i, m_lights[i].Ia);
-		SetLightUniform(&m_phongShader, "Id", i, m_lights[i].Id);
-		SetLightUniform(&m_phongShader, "Is", i, m_lights[i].Is);
-		SetLightUniform(&m_phongShader, "attenuation", i, m_lights[i].attenuation);
-	}
+	m_lightBuffer.update(m_lights.data(), m_lights.size());
+	m_lightBuffer.bind();
 
 	//m_phongShader.bind();
 	//m_phongShader.bindUniform("light.position", m_light.position);
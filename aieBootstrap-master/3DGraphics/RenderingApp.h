@@ -8,7 +8,7 @@
 #include "Shader.h"
 #include "Mesh.h"
 #include "OBJMesh.h"
-#include <sstream>
+#include "LightBuffer.h"
 
 class RenderingApp : public aie::Application
 {
@@ -29,15 +29,6 @@ public:
 	virtual void draw();
 
 	void RunApp();
-	template <typename T>
-	void SetLightUniform(aie::ShaderProgram* shader, const char* propertyName, size_t lightIndex, const T& value)
-	{
-		std::ostringstream ss;
-		ss << "allLights[" << lightIndex << "]." << propertyName;
-		std::string uniformName = ss.str();
-
-		shader->bindUniform(uniformName.c_str(), value);
-	}
 
 protected:
 	/*struct Light
@@ -47,15 +38,6 @@ protected:
 		glm::vec3 specular;
 	};*/
 
-	struct Light
-	{
-		glm::vec4 position;
-		glm::vec3 Ia;
-		glm::vec3 Id;
-		glm::vec3 Is;
-		float attenuation;
-	};
-
 	Camera* m_camera;
 	//aie::ShaderProgram m_simpleShader;
 	//aie::ShaderProgram m_textureShader;
@@ -76,6 +58,7 @@ protected:
 	glm::mat4 m_spearTransform;
 
 	//Light m_light;
-	std::vector<Light> m_lights;
+	std::vector<aie::Light> m_lights;
+	aie::LightBuffer m_lightBuffer;
 	//glm::vec3 m_ambientLight;
 };
\ No newline at end of file
@@ -1,10 +1,41 @@
 #include "Shader.h"
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 #include "gl_core_4_4.h"
+#include "ProgramCache.h"
 
 namespace aie {
 
+namespace {
+
+// puts defines after the #version line, which has to come first, with a #line
+// so errors still give the line numbers of the file
+void insertDefines(std::string& source, const char* defines) {
+
+	if (defines == nullptr ||
+		defines[0] == 0)
+		return;
+
+	size_t insertAt = 0;
+	unsigned int line = 1;
+	size_t version = source.find("#version");
+	if (version != std::string::npos) {
+		insertAt = source.find('\n', version);
+		insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+		line += (unsigned int)std::count(source.begin(), source.begin() + insertAt, '\n');
+	}
+
+	std::string block = defines;
+	if (block.back() != '\n')
+		block += '\n';
+	block += "#line " + std::to_string(line) + "\n";
+	source.insert(insertAt, block);
+}
+
+} // namespace
+
 Shader::~Shader() {
 	glDeleteShader(m_handle);
 }
@@ -37,10 +68,11 @@ bool Shader::loadShader(unsigned int stage, const char* filename) {
 	glShaderSource(m_handle, 1, (const char**)&source, 0);
 	glCompileShader(m_handle);
 
+	m_source = source;
 	delete[] source;
 
 	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
+	glGetShaderiv(m_handle, GL_COMPILE_STATUS, &success);
 	if (success == GL_FALSE) {
 		int infoLogLength = 0;
 		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
@@ -55,6 +87,11 @@ bool Shader::loadShader(unsigned int stage, const char* filename) {
 }
 
 bool Shader::createShader(unsigned int stage, const char* string) {
+	beginShader(stage, string);
+	return checkCompileStatus();
+}
+
+void Shader::beginShader(unsigned int stage, const char* string) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 
 	m_stage = stage;
@@ -70,9 +107,14 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 
 	glShaderSource(m_handle, 1, (const char**)&string, 0);
 	glCompileShader(m_handle);
-	
+
+	m_source = string;
+}
+
+bool Shader::checkCompileStatus() {
+
 	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
+	glGetShaderiv(m_handle, GL_COMPILE_STATUS, &success);
 	if (success == GL_FALSE) {
 		int infoLogLength = 0;
 		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
@@ -91,33 +133,122 @@ ShaderProgram::~ShaderProgram() {
 	glDeleteProgram(m_program);
 }
 
-bool ShaderProgram::loadShader(unsigned int stage, const char* filename) {
+bool ShaderProgram::loadShader(unsigned int stage, const char* filename, const char* defines /* = nullptr */) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->loadShader(stage, filename);
+
+	// open file
+	FILE* file = nullptr;
+	if (fopen_s(&file, filename, "rb") != 0) {
+		setLastError((std::string("Failed to open shader ") + filename).c_str());
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	unsigned int size = ftell(file);
+	std::string source(size, 0);
+	fseek(file, 0, SEEK_SET);
+	fread_s(&source[0], size, sizeof(char), size, file);
+	fclose(file);
+
+	insertDefines(source, defines);
+
+	m_shaders[stage] = nullptr;
+	m_sources[stage] = source;
+	return true;
 }
 
-bool ShaderProgram::createShader(unsigned int stage, const char* string) {
+bool ShaderProgram::createShader(unsigned int stage, const char* string, const char* defines /* = nullptr */) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->createShader(stage, string);
+	m_shaders[stage] = nullptr;
+	m_sources[stage] = string;
+	insertDefines(m_sources[stage], defines);
+	return true;
 }
 
 void ShaderProgram::attachShader(const std::shared_ptr<Shader>& shader) {
 	assert(shader != nullptr);
 	m_shaders[shader->getStage()] = shader;
+	m_sources[shader->getStage()].clear();
 }
 
+unsigned int ShaderProgram::sm_linkCount = 0;
+
 bool ShaderProgram::link() {
+	return linkAsync() && finishLink();
+}
+
+bool ShaderProgram::linkAsync() {
+	++sm_linkCount;
+
 	m_program = glCreateProgram();
+
+	// the cache knows the program by the source of every stage
+	const char* sources[eShaderStage::SHADER_STAGE_Count] = {};
+	bool hasStages = false;
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_sources[stage].empty() == false)
+			sources[stage] = m_sources[stage].c_str();
+		else if (m_shaders[stage] != nullptr)
+			sources[stage] = m_shaders[stage]->getSource().c_str();
+		hasStages |= sources[stage] != nullptr;
+	}
+
+	if (hasStages == false) {
+		setLastError("No shader stages to link");
+		m_linkState = LINK_FAILED;
+		return false;
+	}
+
+	m_cacheKey = ProgramCache::makeKey(sources, eShaderStage::SHADER_STAGE_Count);
+	if (ProgramCache::load(m_program, m_cacheKey)) {
+		m_linkState = LINKED;
+		reflectUniforms();
+		return true;
+	}
+
+	m_linkStart = std::chrono::steady_clock::now();
+	beginLink();
+	m_linkState = LINKING;
+	return true;
+}
+
+void ShaderProgram::beginLink() {
+
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_sources[stage].empty())
+			continue;
+
+		auto shader = std::make_shared<Shader>();
+		shader->beginShader(stage, m_sources[stage].c_str());
+		m_shaders[stage] = shader;
+		m_sources[stage].clear();
+	}
+
 	for (auto& s : m_shaders)
 		if (s != nullptr)
 			glAttachShader(m_program, s->getHandle());
 	glLinkProgram(m_program);
+}
+
+bool ShaderProgram::finishLink() {
+
+	if (m_linkState != LINKING)
+		return m_linkState == LINKED;
 
 	int success = GL_TRUE;
 	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
 	if (success == GL_FALSE) {
+		m_linkState = LINK_FAILED;
+
+		// a stage that didn't compile says more than the link does
+		for (auto& s : m_shaders) {
+			if (s != nullptr &&
+				s->checkCompileStatus() == false) {
+				setLastError(s->getLastError());
+				return false;
+			}
+		}
+
 		int infoLogLength = 0;
 		glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
 
@@ -126,190 +257,285 @@ bool ShaderProgram::link() {
 		glGetProgramInfoLog(m_program, infoLogLength, 0, m_lastError);
 		return false;
 	}
+
+	m_linkState = LINKED;
+	ProgramCache::store(m_program, m_cacheKey);
+	ProgramCache::recordCompile(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_linkStart).count());
+
+	reflectUniforms();
 	return true;
 }
 
+bool ShaderProgram::isLinkComplete() const {
+
+	if (m_linkState != LINKING ||
+		ogl_ext_KHR_parallel_shader_compile != ogl_LOAD_SUCCEEDED)
+		return true;
+
+	int complete = GL_TRUE;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool ShaderProgram::linkAll(ShaderProgram* const* programs, size_t programCount) {
+
+	// as many threads as the driver wants
+	if (ogl_ext_KHR_parallel_shader_compile == ogl_LOAD_SUCCEEDED)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	bool submitted = true;
+	for (size_t i = 0; i < programCount; ++i)
+		if (programs[i]->linkAsync() == false)
+			submitted = false;
+	return submitted;
+}
+
+void ShaderProgram::setLastError(const char* error) {
+	delete[] m_lastError;
+	size_t length = error != nullptr ? strlen(error) : 0;
+	m_lastError = new char[length + 1];
+	if (length > 0)
+		memcpy(m_lastError, error, length);
+	m_lastError[length] = 0;
+}
+
 void ShaderProgram::bind() {
+	if (m_linkState == LINKING &&
+		finishLink() == false)
+		printf("Shader link error: %s\n", m_lastError);
+
 	assert(m_program > 0 && "Invalid shader program");
 	glUseProgram(m_program);
 }
 
-int ShaderProgram::getUniform(const char* name) {
-	return glGetUniformLocation(m_program, name);
+int ShaderProgram::getUniform(const UniformName& name) const {
+
+	if (m_uniforms.empty())
+		return -1;
+
+	size_t mask = m_uniforms.size() - 1;
+	for (size_t i = name.hash & mask;; i = (i + 1) & mask) {
+		const UniformEntry& entry = m_uniforms[i];
+		if (entry.name.empty())
+			return -1;
+		if (entry.hash == name.hash &&
+			entry.name == name.name)
+			return entry.location;
+	}
 }
 
-bool ShaderProgram::bindUniform(const char* name, int value) {
+int ShaderProgram::requireUniform(const UniformName& name) {
+
+	if (m_linkState == LINKING)
+		finishLink();
+
+	int location = getUniform(name);
+	if (location < 0 &&
+		std::find(m_missingUniforms.begin(), m_missingUniforms.end(), name.hash) == m_missingUniforms.end()) {
+		m_missingUniforms.push_back(name.hash);
+		printf("Shader uniform [%s] not found! Is it being used?\n", name.name);
+	}
+	return location;
+}
+
+void ShaderProgram::reflectUniforms() {
+
+	m_uniforms.clear();
+	m_missingUniforms.clear();
+
+	int uniformCount = 0, maxNameLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	// array elements are found by index through the location of each one
+	std::vector<std::pair<std::string, int>> locations;
+	std::vector<char> buffer(maxNameLength + 1);
+	for (int i = 0; i < uniformCount; ++i) {
+		int size = 0;
+		unsigned int type = 0;
+		glGetActiveUniform(m_program, i, (int)buffer.size(), nullptr, &size, &type, buffer.data());
+		std::string name = buffer.data();
+
+		// members of uniform blocks have no location
+		int location = glGetUniformLocation(m_program, name.c_str());
+		if (location < 0)
+			continue;
+		locations.push_back(std::make_pair(name, location));
+
+		size_t bracket = name.rfind("[0]");
+		if (bracket == std::string::npos ||
+			bracket + 3 != name.size())
+			continue;
+
+		std::string arrayName = name.substr(0, bracket);
+		locations.push_back(std::make_pair(arrayName, location));
+		for (int element = 1; element < size; ++element) {
+			std::string elementName = arrayName + "[" + std::to_string(element) + "]";
+			int elementLocation = glGetUniformLocation(m_program, elementName.c_str());
+			if (elementLocation >= 0)
+				locations.push_back(std::make_pair(elementName, elementLocation));
+		}
+	}
+
+	// kept at most half full
+	size_t capacity = 16;
+	while (capacity < locations.size() * 2)
+		capacity *= 2;
+	m_uniforms.resize(capacity);
+
+	size_t mask = capacity - 1;
+	for (auto& uniform : locations) {
+		unsigned int hash = UniformName::hashName(uniform.first.c_str());
+		size_t i = hash & mask;
+		while (m_uniforms[i].name.empty() == false)
+			i = (i + 1) & mask;
+
+		m_uniforms[i].hash = hash;
+		m_uniforms[i].location = uniform.second;
+		m_uniforms[i].name = uniform.first;
+	}
+}
+
+bool ShaderProgram::bindUniform(const UniformName& name, int value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform1i(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, float value) {
+bool ShaderProgram::bindUniform(const UniformName& name, float value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform1f(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec2& value) {
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::vec2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform2f(i, value.x, value.y);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec3& value) {
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::vec3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform3f(i, value.x, value.y, value.z);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec4& value) {
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::vec4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform4f(i, value.x, value.y, value.z, value.w);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat2& value) {
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::mat2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniformMatrix2fv(i, 1, GL_FALSE, &value[0][0]);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat3& value) {
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::mat3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniformMatrix3fv(i, 1, GL_FALSE, &value[0][0]);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat4& value) {
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::mat4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniformMatrix4fv(i, 1, GL_FALSE, &value[0][0]);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, int* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, int* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform1iv(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, float* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, float* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform1fv(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec2* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::vec2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform2fv(i, count, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec3* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::vec3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform3fv(i, count, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec4* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::vec4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniform4fv(i, count, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat2* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::mat2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniformMatrix2fv(i, count, GL_FALSE, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat3* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::mat3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniformMatrix3fv(i, count, GL_FALSE, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat4* value) {
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::mat4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int i = requireUniform(name);
+	if (i < 0)
 		return false;
-	}
 	glUniformMatrix4fv(i, count, GL_FALSE, (float*)value);
 	return true;
 }
@@ -6,7 +6,10 @@
 #include <glm/mat2x2.hpp>
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
+#include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace aie {
 
@@ -37,40 +40,106 @@ public:
 	bool loadShader(unsigned int stage, const char* filename);
 	bool createShader(unsigned int stage, const char* string);
 
+	// starts compiling without waiting for the driver to finish,
+	// checkCompileStatus() waits and fills getLastError() if it failed
+	void beginShader(unsigned int stage, const char* string);
+	bool checkCompileStatus();
+
 	unsigned int getStage() const { return m_stage; }
 	unsigned int getHandle() const { return m_handle; }
 
+	// kept so programs using the shader can be found in the ProgramCache
+	const std::string& getSource() const { return m_source; }
+
 	const char* getLastError() const { return m_lastError; }
 
 protected:
 
 	unsigned int	m_stage;
 	unsigned int	m_handle;
+	std::string		m_source;
 	char*			m_lastError;
 };
 
+// a uniform's name along with its hash, used to find the uniform in a linked
+// program without asking the driver
+// constexpr so a handle made from a string literal is hashed at compile time,
+// e.g. constexpr UniformName PROJECTION_VIEW_MODEL("ProjectionViewModel");
+// the name must outlive the handle
+struct UniformName {
+
+	constexpr UniformName(const char* name) : name(name), hash(hashName(name)) {}
+
+	// 32 bit FNV-1a
+	static constexpr unsigned int hashName(const char* name) {
+		unsigned int hash = 2166136261u;
+		while (*name != 0)
+			hash = (hash ^ (unsigned char)*name++) * 16777619u;
+		return hash;
+	}
+
+	const char*		name;
+	unsigned int	hash;
+};
+
 // combines shaders together into a single program for the GPU
 class ShaderProgram {
 public:
 
-	ShaderProgram() : m_program(0), m_lastError(nullptr) {
+	ShaderProgram() : m_program(0), m_linkState(UNLINKED), m_cacheKey(0), m_lastError(nullptr) {
 		m_shaders[0] = m_shaders[1] = m_shaders[2] = m_shaders[3] = m_shaders[4] = 0;
 	}
 	~ShaderProgram();
 
-	bool loadShader(unsigned int stage, const char* filename);
-	bool createShader(unsigned int stage, const char* string);
+	// the source is kept until link(), which only compiles it when the
+	// ProgramCache has no binary for the program, so compile errors are
+	// reported by link()
+	// defines are lines such as "#define INSTANCED\n" put after the source's
+	// #version, so one file can build several variants of a shader
+	// loadShader() fails if the file can't be read
+	bool loadShader(unsigned int stage, const char* filename, const char* defines = nullptr);
+	bool createShader(unsigned int stage, const char* string, const char* defines = nullptr);
 	void attachShader(const std::shared_ptr<Shader>& shader);
 
+	// loads the program's binary from the ProgramCache if it has one, otherwise
+	// compiles and links the stages and caches the binary
+	// on success every active uniform's location is stored, so looking them up
+	// by name doesn't need the driver
 	bool link();
 
+	// as link(), but only submits the work to the driver without waiting for
+	// it, so the driver can compile other programs at the same time
+	// the link is finished by finishLink(), or by the first bind() which prints
+	// any error, and until then no uniforms are found
+	// fails straight away only if there is nothing to link
+	bool linkAsync();
+
+	// waits for the driver if the program is still linking, returns whether it linked
+	bool finishLink();
+
+	// true once finishLink() won't have to wait, the driver can only say so
+	// with GL_KHR_parallel_shader_compile, without it this is always true
+	bool isLinkComplete() const;
+
+	// links every program with linkAsync(), letting the driver compile on as
+	// many threads as it likes when it supports GL_KHR_parallel_shader_compile
+	// returns false if any failed to submit
+	static bool linkAll(ShaderProgram* const* programs, size_t programCount);
+
 	const char* getLastError() const { return m_lastError; }
 
+	// finishes linking first if it hasn't already
 	void bind();
 
 	unsigned int getHandle() const { return m_program; }
 
-	int getUniform(const char* name);
+	// counts every link by any program, anything caching a program's uniform
+	// locations by handle can compare it to know when they may have changed
+	static unsigned int getLinkCount() { return sm_linkCount; }
+
+	// -1 if the uniform isn't active in the program, or the program hasn't
+	// finished linking
+	int getUniform(const UniformName& name) const;
 
 	void bindUniform(int ID, int value);
 	void bindUniform(int ID, float value);
@@ -90,30 +159,72 @@ public:
 	void bindUniform(int ID, int count, const glm::mat4* value);
 
 	// these calls should be avoided, but wraps up opengl a little
-	bool bindUniform(const char* name, int value);
-	bool bindUniform(const char* name, float value);
-	bool bindUniform(const char* name, const glm::vec2& value);
-	bool bindUniform(const char* name, const glm::vec3& value);
-	bool bindUniform(const char* name, const glm::vec4& value);
-	bool bindUniform(const char* name, const glm::mat2& value);
-	bool bindUniform(const char* name, const glm::mat3& value);
-	bool bindUniform(const char* name, const glm::mat4& value);
-	bool bindUniform(const char* name, int count, int* value);
-	bool bindUniform(const char* name, int count, float* value);
-	bool bindUniform(const char* name, int count, const glm::vec2* value);
-	bool bindUniform(const char* name, int count, const glm::vec3* value);
-	bool bindUniform(const char* name, int count, const glm::vec4* value);
-	bool bindUniform(const char* name, int count, const glm::mat2* value);
-	bool bindUniform(const char* name, int count, const glm::mat3* value);
-	bool bindUniform(const char* name, int count, const glm::mat4* value);
+	// the location comes from the table built by link(), a uniform that isn't
+	// active is only reported the first time it is bound
+	bool bindUniform(const UniformName& name, int value);
+	bool bindUniform(const UniformName& name, float value);
+	bool bindUniform(const UniformName& name, const glm::vec2& value);
+	bool bindUniform(const UniformName& name, const glm::vec3& value);
+	bool bindUniform(const UniformName& name, const glm::vec4& value);
+	bool bindUniform(const UniformName& name, const glm::mat2& value);
+	bool bindUniform(const UniformName& name, const glm::mat3& value);
+	bool bindUniform(const UniformName& name, const glm::mat4& value);
+	bool bindUniform(const UniformName& name, int count, int* value);
+	bool bindUniform(const UniformName& name, int count, float* value);
+	bool bindUniform(const UniformName& name, int count, const glm::vec2* value);
+	bool bindUniform(const UniformName& name, int count, const glm::vec3* value);
+	bool bindUniform(const UniformName& name, int count, const glm::vec4* value);
+	bool bindUniform(const UniformName& name, int count, const glm::mat2* value);
+	bool bindUniform(const UniformName& name, int count, const glm::mat3* value);
+	bool bindUniform(const UniformName& name, int count, const glm::mat4* value);
 
 private:
 
+	// starts compiling the stages that are still source, then attaches and links them
+	void beginLink();
+
+	void setLastError(const char* error);
+
+	// finds the location, reporting a missing uniform once
+	int requireUniform(const UniformName& name);
+
+	// stores the locations of the active uniforms, array elements by index as
+	// well as by the array's name
+	void reflectUniforms();
+
+	// open addressing by hash, empty slots have no name
+	struct UniformEntry {
+		unsigned int	hash;
+		int				location;
+		std::string		name;
+	};
+
 	unsigned int	m_program;
 
+	enum LinkState : unsigned int {
+		UNLINKED = 0,
+		LINKING,		// submitted to the driver, not yet checked
+		LINKED,
+		LINK_FAILED,
+	};
+
+	LinkState		m_linkState;
+
+	// what the binary is cached by, and when compiling started
+	unsigned long long						m_cacheKey;
+	std::chrono::steady_clock::time_point	m_linkStart;
+
+	std::vector<UniformEntry>	m_uniforms;
+	std::vector<unsigned int>	m_missingUniforms;	// hashes already reported
+
 	std::shared_ptr<Shader> m_shaders[eShaderStage::SHADER_STAGE_Count];
 
+	// stages loaded in to the program that haven't needed compiling yet
+	std::string		m_sources[eShaderStage::SHADER_STAGE_Count];
+
 	char*			m_lastError;
+
+	static unsigned int	sm_linkCount;
 };
 
 }
\ No newline at end of file
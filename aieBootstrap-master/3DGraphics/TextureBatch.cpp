@@ -0,0 +1,53 @@
+#include "TextureBatch.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdio>
+
+namespace aie {
+
+size_t TextureBatch::add(const std::string& filename) {
+	Image image;
+	image.filename = filename;
+	image.decodeMilliseconds = 0;
+	image.decoded = false;
+	m_images.push_back(image);
+	return m_images.size() - 1;
+}
+
+void TextureBatch::wait() {
+
+	std::vector<size_t> pending;
+	for (size_t i = 0; i < m_images.size(); ++i)
+		if (m_images[i].decoded == false)
+			pending.push_back(i);
+
+	auto start = std::chrono::steady_clock::now();
+
+	// each job only touches its own image
+	ThreadPool::get().parallelFor((unsigned int)pending.size(), [this, &pending](unsigned int job) {
+		Image& image = m_images[pending[job]];
+
+		auto decodeStart = std::chrono::steady_clock::now();
+		image.texture = TextureCache::decode(image.filename);
+		image.decodeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+		image.decoded = true;
+	});
+
+	m_waitMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TextureBatch::printDecodeTimes() const {
+
+	float total = 0;
+	for (auto& image : m_images) {
+		printf("%s %s in %.2fms\n", image.filename.c_str(),
+			   image.texture != nullptr ? "decoded" : "failed to decode", image.decodeMilliseconds);
+		total += image.decodeMilliseconds;
+	}
+
+	if (m_images.empty() == false)
+		printf("%u images decoded in %.2fms (%.2fms of decoding)\n", (unsigned int)m_images.size(), m_waitMilliseconds, total);
+}
+
+} // namespace aie
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Texture.h"
+
+namespace aie {
+
+// a set of images decoded together through the TextureCache, spread over the
+// shared ThreadPool so that only the uploads are left for the thread that owns
+// the opengl context
+class TextureBatch {
+public:
+
+	TextureBatch() : m_waitMilliseconds(0) {}
+	~TextureBatch() {}
+
+	// returns the index of the image in the batch
+	size_t add(const std::string& filename);
+
+	// decodes every image added since the last wait on the pool and the calling
+	// thread, returning once they have all finished
+	// safe to call from a job running on the ThreadPool
+	void wait();
+
+	size_t getCount() const { return m_images.size(); }
+	const std::string& getFilename(size_t index) const { return m_images[index].filename; }
+
+	// null if the image couldn't be decoded, or hasn't been waited on yet
+	const std::shared_ptr<Texture>& getTexture(size_t index) const { return m_images[index].texture; }
+
+	// time spent decoding the image, close to 0 when the cache already had it
+	float getDecodeMilliseconds(size_t index) const { return m_images[index].decodeMilliseconds; }
+
+	// prints the decode time of each image and the total for the batch
+	void printDecodeTimes() const;
+
+private:
+
+	TextureBatch(const TextureBatch&) = delete;
+	TextureBatch& operator = (const TextureBatch&) = delete;
+
+	struct Image {
+		std::string					filename;
+		std::shared_ptr<Texture>	texture;
+		float						decodeMilliseconds;
+		bool						decoded;
+	};
+
+	std::vector<Image>	m_images;
+	float				m_waitMilliseconds;	// wall time of the waits, shorter than the sum of the decodes
+};
+
+} // namespace aie
@@ -0,0 +1,94 @@
+#include "TextureCache.h"
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <algorithm>
+#include <cctype>
+#else
+#include <climits>
+#endif
+
+namespace aie {
+
+namespace {
+
+// a texture and whether it decoded, decoding happens once outside the cache lock
+struct CachedTexture {
+	Texture			texture;
+	std::once_flag	decoded;
+	bool			valid;
+};
+
+// file scope so they outlive the loader thread pool during shutdown
+std::unordered_map<std::string, std::weak_ptr<CachedTexture>>	s_textures;
+std::mutex														s_mutex;
+
+} // namespace
+
+std::shared_ptr<Texture> TextureCache::decode(const std::string& filename) {
+
+	std::string path = getCanonicalPath(filename);
+
+	std::shared_ptr<CachedTexture> cached;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		std::weak_ptr<CachedTexture>& entry = s_textures[path];
+		cached = entry.lock();
+		if (cached == nullptr) {
+			cached = std::make_shared<CachedTexture>();
+			cached->valid = false;
+			entry = cached;
+		}
+	}
+
+	std::call_once(cached->decoded, [&]() {
+		cached->valid = cached->texture.decode(filename.c_str());
+	});
+
+	if (cached->valid == false)
+		return nullptr;
+
+	// shares ownership of the whole entry
+	return std::shared_ptr<Texture>(cached, &cached->texture);
+}
+
+size_t TextureCache::getTextureCount() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	// drop the entries of textures that have been released while counting
+	size_t count = 0;
+	for (auto entry = s_textures.begin(); entry != s_textures.end();) {
+		if (entry->second.expired())
+			entry = s_textures.erase(entry);
+		else {
+			++count;
+			++entry;
+		}
+	}
+	return count;
+}
+
+std::string TextureCache::getCanonicalPath(const std::string& filename) {
+
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, filename.c_str(), _MAX_PATH) == nullptr)
+		return filename;
+
+	// windows paths aren't case sensitive and take either slash
+	std::string path = buffer;
+	std::transform(path.begin(), path.end(), path.begin(), [](char c) {
+		return c == '/' ? '\\' : (char)std::tolower((unsigned char)c);
+	});
+	return path;
+#else
+	char buffer[PATH_MAX];
+	if (realpath(filename.c_str(), buffer) == nullptr)
+		return filename;
+	return buffer;
+#endif
+}
+
+} // namespace aie
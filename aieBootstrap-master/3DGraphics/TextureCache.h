@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "Texture.h"
+
+namespace aie {
+
+// textures shared between everything that loads the same image, keyed by the
+// image's canonical path so that different relative paths to one file match
+// a texture stays cached for as long as something holds a reference to it,
+// and the last reference should be released on the thread that owns the
+// opengl context once it has been uploaded
+class TextureCache {
+public:
+
+	// returns the texture for filename, decoding it the first time it is asked
+	// for, or null if it can't be decoded
+	// safe to call from any thread, a second caller asking for an image that is
+	// still being decoded waits for it rather than decoding it again
+	// the texture is only decoded, call upload() on it from the thread that
+	// owns the context if its handle is still 0
+	static std::shared_ptr<Texture> decode(const std::string& filename);
+
+	// the number of textures still referenced
+	static size_t getTextureCount();
+
+	// the absolute path of filename with any . or .. removed, or filename
+	// itself if it can't be resolved
+	static std::string getCanonicalPath(const std::string& filename);
+};
+
+} // namespace aie
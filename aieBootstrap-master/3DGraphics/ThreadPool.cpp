@@ -0,0 +1,104 @@
+#include "ThreadPool.h"
+#include <atomic>
+
+namespace aie {
+
+ThreadPool::ThreadPool(unsigned int threadCount /* = 0 */)
+	: m_stopping(false) {
+
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	m_threads.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_threads.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& t : m_threads)
+		t.join();
+}
+
+ThreadPool& ThreadPool::get() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)>& function) {
+
+	if (count == 0)
+		return;
+
+	// shared with helpers that may only start running after this has returned
+	struct Progress {
+		std::atomic<unsigned int>	next;
+		std::atomic<unsigned int>	finished;
+		std::mutex					mutex;
+		std::condition_variable		done;
+	};
+	auto progress = std::make_shared<Progress>();
+	progress->next = 0;
+	progress->finished = 0;
+
+	// jobs are claimed one at a time, function is only used once a job has
+	// been claimed and so is still alive
+	auto run = [progress, count, &function]() {
+		for (;;) {
+			unsigned int job = progress->next++;
+			if (job >= count)
+				return;
+
+			function(job);
+
+			if (++progress->finished == count) {
+				std::lock_guard<std::mutex> lock(progress->mutex);
+				progress->done.notify_all();
+			}
+		}
+	};
+
+	unsigned int helpers = count - 1 < getThreadCount() ? count - 1 : getThreadCount();
+	for (unsigned int i = 0; i < helpers; ++i)
+		enqueue(run);
+
+	run();
+
+	std::unique_lock<std::mutex> lock(progress->mutex);
+	progress->done.wait(lock, [&]() { return progress->finished == count; });
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+}
+
+void ThreadPool::work() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stopping || m_jobs.empty() == false; });
+
+			// only stop once the queue has drained
+			if (m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+}
+
+} // namespace aie
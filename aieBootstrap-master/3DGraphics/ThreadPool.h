@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aie {
+
+// a fixed set of worker threads that run jobs in the order they are submitted
+// jobs shouldn't block waiting on other jobs in the same pool
+class ThreadPool {
+public:
+
+	// 0 creates one thread per hardware thread
+	ThreadPool(unsigned int threadCount = 0);
+
+	// finishes any jobs still queued before returning
+	~ThreadPool();
+
+	// queues a job, the future holds its result or the exception it threw
+	template <typename Function>
+	auto submit(Function function) -> std::future<decltype(function())> {
+		typedef decltype(function()) Result;
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+		std::future<Result> result = task->get_future();
+		enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	// runs function(0) to function(count - 1) spread over the pool and the
+	// calling thread, returning once they have all finished
+	// the calling thread works through the jobs too, so this is safe to call
+	// from inside a job running on the same pool
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& function);
+
+	unsigned int getThreadCount() const { return (unsigned int)m_threads.size(); }
+
+	// pool shared by the asset loaders, created on first use
+	static ThreadPool& get();
+
+private:
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+
+	void enqueue(std::function<void()> job);
+	void work();
+
+	std::vector<std::thread>			m_threads;
+	std::deque<std::function<void()>>	m_jobs;
+	std::mutex							m_mutex;
+	std::condition_variable				m_wake;
+	bool								m_stopping;
+};
+
+} // namespace aie
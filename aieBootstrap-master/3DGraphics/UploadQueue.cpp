@@ -0,0 +1,58 @@
+#include "UploadQueue.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace aie {
+
+namespace {
+
+// file scope so they outlive the loader thread pool during shutdown
+std::deque<std::function<void()>>	s_jobs;
+std::mutex							s_mutex;
+
+bool popJob(std::function<void()>& job) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (s_jobs.empty())
+		return false;
+
+	job = std::move(s_jobs.front());
+	s_jobs.pop_front();
+	return true;
+}
+
+} // namespace
+
+void UploadQueue::push(std::function<void()> job) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_jobs.push_back(std::move(job));
+}
+
+size_t UploadQueue::process(float budgetMilliseconds) {
+
+	auto start = std::chrono::steady_clock::now();
+	auto budget = std::chrono::duration<float, std::milli>(budgetMilliseconds);
+
+	std::function<void()> job;
+	while (popJob(job)) {
+		job();
+
+		if (std::chrono::steady_clock::now() - start >= budget)
+			break;
+	}
+
+	return getPendingCount();
+}
+
+void UploadQueue::flush() {
+	std::function<void()> job;
+	while (popJob(job))
+		job();
+}
+
+size_t UploadQueue::getPendingCount() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_jobs.size();
+}
+
+} // namespace aie
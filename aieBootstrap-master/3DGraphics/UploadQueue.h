@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace aie {
+
+// jobs that have to run on the thread that owns the opengl context, such as
+// creating the buffers and textures for assets loaded on other threads
+class UploadQueue {
+public:
+
+	// safe to call from any thread
+	static void push(std::function<void()> job);
+
+	// runs queued jobs on the calling thread until the queue is empty or the
+	// budget has been spent, at least one job runs so the queue always drains
+	// returns the number of jobs still waiting
+	static size_t process(float budgetMilliseconds);
+
+	// runs every queued job, including any they queue themselves
+	static void flush();
+
+	static size_t getPendingCount();
+};
+
+} // namespace aie
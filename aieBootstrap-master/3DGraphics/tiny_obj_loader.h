@@ -43,6 +43,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <functional>
 
 namespace tinyobj {
 
@@ -109,8 +110,11 @@ public:
 
 class MaterialFileReader : public MaterialReader {
 public:
-  MaterialFileReader(const std::string &mtl_basepath)
-      : m_mtlBasePath(mtl_basepath) {}
+  /// 'mtl_files' is optional, the name of each material file asked for is
+  /// added to it once, relative to 'mtl_basepath', whether it was found or not.
+  MaterialFileReader(const std::string &mtl_basepath,
+                     std::vector<std::string> *mtl_files = NULL)
+      : m_mtlBasePath(mtl_basepath), m_mtlFiles(mtl_files) {}
   virtual ~MaterialFileReader() {}
   virtual bool operator()(const std::string &matId,
                           std::vector<material_t> &materials,
@@ -118,6 +122,7 @@ public:
 
 private:
   std::string m_mtlBasePath;
+  std::vector<std::string> *m_mtlFiles;
 };
 
 /// Loads .obj from a file.
@@ -128,11 +133,17 @@ private:
 /// 'mtl_basepath' is optional, and used for base path for .mtl file.
 /// 'triangulate' is optional, and used whether triangulate polygon face in .obj
 /// or not.
+/// 'num_threads' is optional, the file is split at line boundaries and each
+/// part is tokenised on its own thread before being stitched back together in
+/// file order. 0 uses every hardware thread, 1 parses on the calling thread.
+/// 'mtl_files' is optional, and filled with the name of every material file
+/// the .obj refers to, relative to 'mtl_basepath'.
 bool LoadObj(std::vector<shape_t> &shapes,       // [output]
              std::vector<material_t> &materials, // [output]
              std::string &err,                   // [output]
              const char *filename, const char *mtl_basepath = NULL,
-             bool triangulate = true);
+             bool triangulate = true, unsigned int num_threads = 0,
+             std::vector<std::string> *mtl_files = NULL);
 
 /// Loads object from a std::istream, uses GetMtlIStreamFn to retrieve
 /// std::istream for materials.
@@ -144,6 +155,23 @@ bool LoadObj(std::vector<shape_t> &shapes,       // [output]
              std::istream &inStream, MaterialReader &readMatFn,
              bool triangulate = true);
 
+/// Receives each shape as soon as the group, object or material it belongs to
+/// is finished. The shape is discarded once the callback returns, so its data
+/// may be swapped or moved out of it.
+typedef std::function<void(shape_t &shape)> shape_callback;
+
+/// Loads .obj from a file a line at a time, passing each shape to `callback`
+/// instead of collecting them all. Only the v/vn/vt records (which faces may
+/// reference from anywhere in the file) and the shape being built are held in
+/// memory, so peak usage follows the largest group rather than the whole file.
+/// 'materials' and 'mtl_files' are only complete once the function returns.
+bool LoadObjStreaming(const shape_callback &callback,     // [output]
+                      std::vector<material_t> &materials, // [output]
+                      std::string &err,                   // [output]
+                      const char *filename, const char *mtl_basepath = NULL,
+                      bool triangulate = true,
+                      std::vector<std::string> *mtl_files = NULL);
+
 /// Loads materials into std::map
 void LoadMtl(std::map<std::string, int> &material_map, // [output]
              std::vector<material_t> &materials,       // [output]
@@ -163,6 +191,10 @@ void LoadMtl(std::map<std::string, int> &material_map, // [output]
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <algorithm>
 
 #include "tiny_obj_loader.h"
 
@@ -187,17 +219,91 @@ struct tag_sizes {
   int num_strings;
 };
 
-// for std::map
-static inline bool operator<(const vertex_index &a, const vertex_index &b) {
-  if (a.v_idx != b.v_idx)
-    return (a.v_idx < b.v_idx);
-  if (a.vn_idx != b.vn_idx)
-    return (a.vn_idx < b.vn_idx);
-  if (a.vt_idx != b.vt_idx)
-    return (a.vt_idx < b.vt_idx);
+// Maps a v/vt/vn triple to the index of the vertex built for it.
+// Open addressing with linear probing over a flat power of two table. Each
+// slot is stamped with the generation it was written in, so clearing between
+// face groups is O(1) and the storage is reused for the next group.
+class vertex_cache {
+public:
+  vertex_cache() : mask(0), count(0), generation(1) {}
+
+  void clear() {
+    count = 0;
+    generation++;
+    if (generation == 0) {
+      // stamps wrapped around, wipe them for real
+      for (size_t i = 0; i < slots.size(); i++)
+        slots[i].generation = 0;
+      generation = 1;
+    }
+  }
 
-  return false;
-}
+  // Returns the stored index, or inserts `idx` and returns it.
+  unsigned int find_or_insert(const vertex_index &key, unsigned int idx,
+                              bool &inserted) {
+    if ((count + 1) * 2 > slots.size())
+      rehash(slots.empty() ? 16 : slots.size() * 2);
+
+    size_t i = hash(key) & mask;
+    for (;;) {
+      slot &s = slots[i];
+      if (s.generation != generation) {
+        s.key = key;
+        s.value = idx;
+        s.generation = generation;
+        count++;
+        inserted = true;
+        return idx;
+      }
+      if (s.key.v_idx == key.v_idx && s.key.vt_idx == key.vt_idx &&
+          s.key.vn_idx == key.vn_idx) {
+        inserted = false;
+        return s.value;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+
+private:
+  struct slot {
+    vertex_index key;
+    unsigned int value;
+    unsigned int generation;
+    slot() : key(-1), value(0), generation(0) {}
+  };
+
+  static size_t hash(const vertex_index &k) {
+    unsigned int h = static_cast<unsigned int>(k.v_idx) * 0x9E3779B1u;
+    h ^= static_cast<unsigned int>(k.vt_idx) * 0x85EBCA77u;
+    h ^= static_cast<unsigned int>(k.vn_idx) * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 13;
+    return h;
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<slot> old;
+    old.swap(slots);
+    slots.resize(capacity);
+    mask = capacity - 1;
+    count = 0;
+
+    unsigned int old_generation = generation;
+    generation = 1;
+    for (size_t i = 0; i < old.size(); i++) {
+      if (old[i].generation != old_generation)
+        continue;
+      bool inserted;
+      find_or_insert(old[i].key, old[i].value, inserted);
+    }
+  }
+
+  std::vector<slot> slots;
+  size_t mask;
+  size_t count;
+  unsigned int generation;
+};
 
 struct obj_shape {
   std::vector<float> v;
@@ -207,6 +313,8 @@ struct obj_shape {
 
 static inline bool isSpace(const char c) { return (c == ' ') || (c == '\t'); }
 
+static inline bool isDigit(const char c) { return (c >= '0') && (c <= '9'); }
+
 static inline bool isNewLine(const char c) {
   return (c == '\r') || (c == '\n') || (c == '\0');
 }
@@ -367,16 +475,118 @@ assemble:
 fail:
   return false;
 }
+// Fast path for the plain decimal forms that exporters write, such as
+// "-0.5", "12" or "1.0e-05", modelled on std::from_chars. Digits are gathered
+// in to an integer in a single pass and scaled by an exact power of ten, which
+// is correctly rounded whenever the mantissa fits in 53 bits and the exponent
+// is at most 22 (Clinger's fast path). No locale is consulted.
+//
+// On success `end` is set to the character after the number, which must be
+// whitespace or the end of the line. Anything else (long mantissas, large
+// exponents, trailing garbage, malformed numbers) returns false so that
+// tryParseDouble can handle it exactly as before.
+static inline bool tryParseFloatFast(const char *s, const char **end,
+                                     float *result) {
+  static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char *curr = s;
+
+  bool negative = false;
+  if (*curr == '+' || *curr == '-') {
+    negative = (*curr == '-');
+    curr++;
+  }
+
+  // Integer part, at least one digit is required.
+  if (!isDigit(*curr))
+    return false;
+
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+
+  while (isDigit(*curr)) {
+    if (mantissa != 0 || *curr != '0')
+      digits++;
+    mantissa = mantissa * 10 + static_cast<unsigned int>(*curr - '0');
+    curr++;
+    if (digits > 15)
+      return false;
+  }
+
+  // Fractional part.
+  if (*curr == '.') {
+    curr++;
+    while (isDigit(*curr)) {
+      if (mantissa != 0 || *curr != '0')
+        digits++;
+      mantissa = mantissa * 10 + static_cast<unsigned int>(*curr - '0');
+      exponent--;
+      curr++;
+      if (digits > 15)
+        return false;
+    }
+  }
+
+  // Exponent part, at least one digit is required.
+  if (*curr == 'e' || *curr == 'E') {
+    curr++;
+    bool negative_exponent = false;
+    if (*curr == '+' || *curr == '-') {
+      negative_exponent = (*curr == '-');
+      curr++;
+    }
+    if (!isDigit(*curr))
+      return false;
+
+    int e = 0;
+    while (isDigit(*curr)) {
+      e = e * 10 + (*curr - '0');
+      curr++;
+      if (e > 1000)
+        return false;
+    }
+    exponent += negative_exponent ? -e : e;
+  }
+
+  // Must end at a separator, otherwise leave it to the slow path.
+  if (!isSpace(*curr) && *curr != '\r' && *curr != '\0')
+    return false;
+
+  // 15 digits always fit in the 53 bit mantissa of a double.
+  double value = static_cast<double>(mantissa);
+  if (mantissa != 0) {
+    if (exponent < -22 || exponent > 22)
+      return false;
+    if (exponent < 0)
+      value /= powers[-exponent];
+    else
+      value *= powers[exponent];
+  }
+
+  *result = static_cast<float>(negative ? -value : value);
+  *end = curr;
+  return true;
+}
+
 static inline float parseFloat(const char *&token) {
-  token += strspn(token, " \t");
+  while (isSpace(*token))
+    token++;
 #ifdef TINY_OBJ_LOADER_OLD_FLOAT_PARSER
   float f = (float)atof(token);
   token += strcspn(token, " \t\r");
 #else
+  float f;
+  if (tryParseFloatFast(token, &token, &f))
+    return f;
+
   const char *end = token + strcspn(token, " \t\r");
   double val = 0.0;
   tryParseDouble(token, end, &val);
-  float f = static_cast<float>(val);
+  f = static_cast<float>(val);
   token = end;
 #endif
   return f;
@@ -417,13 +627,43 @@ static tag_sizes parseTagTriple(const char *&token) {
   return ts;
 }
 
+// Parses one index of a face triple and moves past it to the next separator.
+// Plain [sign]digits are read in a single pass, anything else falls back to
+// atoi() and strcspn() so malformed input behaves as it always has.
+static inline int parseIndex(const char *&token) {
+  const char *curr = token;
+
+  bool negative = false;
+  if (*curr == '+' || *curr == '-') {
+    negative = (*curr == '-');
+    curr++;
+  }
+
+  if (isDigit(*curr)) {
+    int i = 0;
+    int digits = 0;
+    while (isDigit(*curr) && digits < 9) {
+      i = i * 10 + (*curr - '0');
+      curr++;
+      digits++;
+    }
+    if (*curr == '/' || isSpace(*curr) || *curr == '\r' || *curr == '\0') {
+      token = curr;
+      return negative ? -i : i;
+    }
+  }
+
+  int i = atoi(token);
+  token += strcspn(token, "/ \t\r");
+  return i;
+}
+
 // Parse triples: i, i/j/k, i//k, i/j
 static vertex_index parseTriple(const char *&token, int vsize, int vnsize,
                                 int vtsize) {
   vertex_index vi(-1);
 
-  vi.v_idx = fixIndex(atoi(token), vsize);
-  token += strcspn(token, "/ \t\r");
+  vi.v_idx = fixIndex(parseIndex(token), vsize);
   if (token[0] != '/') {
     return vi;
   }
@@ -432,37 +672,55 @@ static vertex_index parseTriple(const char *&token, int vsize, int vnsize,
   // i//k
   if (token[0] == '/') {
     token++;
-    vi.vn_idx = fixIndex(atoi(token), vnsize);
-    token += strcspn(token, "/ \t\r");
+    vi.vn_idx = fixIndex(parseIndex(token), vnsize);
     return vi;
   }
 
   // i/j/k or i/j
-  vi.vt_idx = fixIndex(atoi(token), vtsize);
-  token += strcspn(token, "/ \t\r");
+  vi.vt_idx = fixIndex(parseIndex(token), vtsize);
   if (token[0] != '/') {
     return vi;
   }
 
   // i/j/k
   token++; // skip '/'
-  vi.vn_idx = fixIndex(atoi(token), vnsize);
-  token += strcspn(token, "/ \t\r");
+  vi.vn_idx = fixIndex(parseIndex(token), vnsize);
   return vi;
 }
 
+// The faces of the group currently being read, stored flat rather than as a
+// vector per face so large groups don't pay for an allocation per polygon.
+struct face_group {
+  std::vector<vertex_index> indices;
+  std::vector<unsigned int> num_indices; // per face
+
+  bool empty() const { return num_indices.empty(); }
+
+  // keeps the capacity, it is reused by the next group
+  void clear() {
+    indices.clear();
+    num_indices.clear();
+  }
+
+  void push_back(const vertex_index *face, size_t count) {
+    indices.insert(indices.end(), face, face + count);
+    num_indices.push_back(static_cast<unsigned int>(count));
+  }
+};
+
 static unsigned int
-updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
-             std::vector<float> &positions, std::vector<float> &normals,
-             std::vector<float> &texcoords,
+updateVertex(vertex_cache &vertexCache, std::vector<float> &positions,
+             std::vector<float> &normals, std::vector<float> &texcoords,
              const std::vector<float> &in_positions,
              const std::vector<float> &in_normals,
              const std::vector<float> &in_texcoords, const vertex_index &i) {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
+  bool inserted = false;
+  unsigned int idx = vertexCache.find_or_insert(
+      i, static_cast<unsigned int>(positions.size() / 3), inserted);
 
-  if (it != vertexCache.end()) {
+  if (!inserted) {
     // found cache
-    return it->second;
+    return idx;
   }
 
   assert(in_positions.size() > static_cast<unsigned int>(3 * i.v_idx + 2));
@@ -484,9 +742,6 @@ updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
     texcoords.push_back(in_texcoords[2 * static_cast<size_t>(i.vt_idx) + 1]);
   }
 
-  unsigned int idx = static_cast<unsigned int>(positions.size() / 3 - 1);
-  vertexCache[i] = idx;
-
   return idx;
 }
 
@@ -514,26 +769,27 @@ static void InitMaterial(material_t &material) {
 }
 
 static bool exportFaceGroupToShape(
-    shape_t &shape, std::map<vertex_index, unsigned int> vertexCache,
+    shape_t &shape, vertex_cache &vertexCache,
     const std::vector<float> &in_positions,
     const std::vector<float> &in_normals,
     const std::vector<float> &in_texcoords,
-    const std::vector<std::vector<vertex_index> > &faceGroup,
-    std::vector<tag_t> &tags, const int material_id, const std::string &name,
-    bool clearCache, bool triangulate) {
+    const face_group &faceGroup, std::vector<tag_t> &tags,
+    const int material_id, const std::string &name, bool clearCache,
+    bool triangulate) {
   if (faceGroup.empty()) {
     return false;
   }
 
   // Flatten vertices and indices
-  for (size_t i = 0; i < faceGroup.size(); i++) {
-    const std::vector<vertex_index> &face = faceGroup[i];
+  const vertex_index *face = faceGroup.indices.data();
+  for (size_t i = 0; i < faceGroup.num_indices.size();
+       face += faceGroup.num_indices[i], i++) {
 
     vertex_index i0 = face[0];
     vertex_index i1(-1);
     vertex_index i2 = face[1];
 
-    size_t npolys = face.size();
+    size_t npolys = faceGroup.num_indices[i];
 
     if (triangulate) {
 
@@ -818,6 +1074,11 @@ bool MaterialFileReader::operator()(const std::string &matId,
                                     std::string &err) {
   std::string filepath;
 
+  if (m_mtlFiles && std::find(m_mtlFiles->begin(), m_mtlFiles->end(),
+                              matId) == m_mtlFiles->end()) {
+    m_mtlFiles->push_back(matId);
+  }
+
   if (!m_mtlBasePath.empty()) {
     filepath = std::string(m_mtlBasePath) + matId;
   } else {
@@ -835,50 +1096,200 @@ bool MaterialFileReader::operator()(const std::string &matId,
   return true;
 }
 
-bool LoadObj(std::vector<shape_t> &shapes,       // [output]
-             std::vector<material_t> &materials, // [output]
-             std::string &err, const char *filename, const char *mtl_basepath,
-             bool trianglulate) {
+// State carried between the statements that build shapes.
+struct obj_parse_state {
+  std::vector<tag_t> tags;
+  face_group faceGroup;
+  std::string name;
 
-  shapes.clear();
+  // material
+  std::map<std::string, int> material_map;
+  vertex_cache vertexCache;
+  int material;
 
-  std::stringstream errss;
+  shape_t shape;
 
-  std::ifstream ifs(filename);
-  if (!ifs) {
-    errss << "Cannot open file [" << filename << "]" << std::endl;
-    err = errss.str();
-    return false;
+  // finished shapes are handed to `callback` if set, else added to `shapes`
+  std::vector<shape_t> *shapes;
+  const shape_callback *callback;
+
+  obj_parse_state() : material(-1), shapes(NULL), callback(NULL) {}
+};
+
+// Turns the current face group in to a shape and passes it on.
+static void flushFaceGroup(obj_parse_state &state, const std::vector<float> &v,
+                           const std::vector<float> &vn,
+                           const std::vector<float> &vt, bool triangulate) {
+  bool ret = exportFaceGroupToShape(state.shape, state.vertexCache, v, vn, vt,
+                                    state.faceGroup, state.tags,
+                                    state.material, state.name, true,
+                                    triangulate);
+  if (ret) {
+    if (state.callback)
+      (*state.callback)(state.shape);
+    else
+      state.shapes->push_back(std::move(state.shape));
   }
+  state.shape = shape_t();
+  state.faceGroup.clear();
+}
 
-  std::string basePath;
-  if (mtl_basepath) {
-    basePath = mtl_basepath;
+// Handles the usemtl, mtllib, g, o and t statements which have to be applied
+// in file order. Returns false if `token` is not one of them.
+// `failed` is set when the material reader reports an error.
+static bool parseShapeStatement(const char *token, obj_parse_state &state,
+                                const std::vector<float> &v,
+                                const std::vector<float> &vn,
+                                const std::vector<float> &vt,
+                                std::vector<material_t> &materials,
+                                MaterialReader &readMatFn, std::string &err,
+                                bool triangulate, bool &failed) {
+  // use mtl
+  if ((0 == strncmp(token, "usemtl", 6)) && isSpace((token[6]))) {
+
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    token += 7;
+#ifdef _MSC_VER
+    sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+    sscanf(token, "%s", namebuf);
+#endif
+
+    // Create face group per material.
+    flushFaceGroup(state, v, vn, vt, triangulate);
+
+    if (state.material_map.find(namebuf) != state.material_map.end()) {
+      state.material = state.material_map[namebuf];
+    } else {
+      // { error!! material not found }
+      state.material = -1;
+    }
+
+    return true;
+  }
+
+  // load mtl
+  if ((0 == strncmp(token, "mtllib", 6)) && isSpace((token[6]))) {
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    token += 7;
+#ifdef _MSC_VER
+    sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+    sscanf(token, "%s", namebuf);
+#endif
+
+    std::string err_mtl;
+    bool ok = readMatFn(namebuf, materials, state.material_map, err_mtl);
+    err += err_mtl;
+
+    if (!ok) {
+      state.faceGroup.clear(); // for safety
+      failed = true;
+    }
+
+    return true;
+  }
+
+  // group name
+  if (token[0] == 'g' && isSpace((token[1]))) {
+
+    // flush previous face group.
+    flushFaceGroup(state, v, vn, vt, triangulate);
+
+    // material = -1;
+
+    std::vector<std::string> names;
+    while (!isNewLine(token[0])) {
+      std::string str = parseString(token);
+      names.push_back(str);
+      token += strspn(token, " \t\r"); // skip tag
+    }
+
+    assert(names.size() > 0);
+
+    // names[0] must be 'g', so skip the 0th element.
+    if (names.size() > 1) {
+      state.name = names[1];
+    } else {
+      state.name = "";
+    }
+
+    return true;
   }
-  MaterialFileReader matFileReader(basePath);
 
-  return LoadObj(shapes, materials, err, ifs, matFileReader, trianglulate);
+  // object name
+  if (token[0] == 'o' && isSpace((token[1]))) {
+
+    // flush previous face group.
+    flushFaceGroup(state, v, vn, vt, triangulate);
+
+    // material = -1;
+
+    // @todo { multiple object name? }
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    token += 2;
+#ifdef _MSC_VER
+    sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+    sscanf(token, "%s", namebuf);
+#endif
+    state.name = std::string(namebuf);
+
+    return true;
+  }
+
+  if (token[0] == 't' && isSpace(token[1])) {
+    tag_t tag;
+
+    char namebuf[4096];
+    token += 2;
+    sscanf_s(token, "%s", namebuf, 4096);
+    tag.name = std::string(namebuf);
+
+    token += tag.name.size() + 1;
+
+    tag_sizes ts = parseTagTriple(token);
+
+    tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+      tag.intValues[i] = atoi(token);
+      token += strcspn(token, "/ \t\r") + 1;
+    }
+
+    tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
+      tag.floatValues[i] = parseFloat(token);
+      token += strcspn(token, "/ \t\r") + 1;
+    }
+
+    tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+      char stringValueBuffer[4096];
+
+      sscanf_s(token, "%s", stringValueBuffer, 4096);
+      tag.stringValues[i] = stringValueBuffer;
+      token += tag.stringValues[i].size() + 1;
+    }
+
+    state.tags.push_back(tag);
+    return true;
+  }
+
+  return false;
 }
 
-bool LoadObj(std::vector<shape_t> &shapes,       // [output]
-             std::vector<material_t> &materials, // [output]
-             std::string &err, std::istream &inStream,
-             MaterialReader &readMatFn, bool triangulate) {
+// Serial parser shared by the istream and streaming loaders, finished shapes
+// are passed on through `state`.
+static bool LoadObjSerial(obj_parse_state &state,
+                          std::vector<material_t> &materials, std::string &err,
+                          std::istream &inStream, MaterialReader &readMatFn,
+                          bool triangulate) {
   std::stringstream errss;
 
   std::vector<float> v;
   std::vector<float> vn;
   std::vector<float> vt;
-  std::vector<tag_t> tags;
-  std::vector<std::vector<vertex_index> > faceGroup;
-  std::string name;
-
-  // material
-  std::map<std::string, int> material_map;
-  std::map<vertex_index, unsigned int> vertexCache;
-  int material = -1;
-
-  shape_t shape;
 
   int maxchars = 8192;                                  // Alloc enough size.
   std::vector<char> buf(static_cast<size_t>(maxchars)); // Alloc enough size.
@@ -950,188 +1361,398 @@ bool LoadObj(std::vector<shape_t> &shapes,       // [output]
       token += 2;
       token += strspn(token, " \t");
 
-      std::vector<vertex_index> face;
+      // written straight in to the group
+      size_t first = state.faceGroup.indices.size();
       while (!isNewLine(token[0])) {
         vertex_index vi = parseTriple(token, static_cast<int>(v.size() / 3),
                                       static_cast<int>(vn.size() / 3),
                                       static_cast<int>(vt.size() / 2));
-        face.push_back(vi);
+        state.faceGroup.indices.push_back(vi);
         size_t n = strspn(token, " \t\r");
         token += n;
       }
 
-      faceGroup.push_back(face);
+      // a face needs at least three corners, drop points and lines
+      size_t num_indices = state.faceGroup.indices.size() - first;
+      if (num_indices < 3) {
+        state.faceGroup.indices.resize(first);
+        continue;
+      }
+      state.faceGroup.num_indices.push_back(
+          static_cast<unsigned int>(num_indices));
 
       continue;
     }
 
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6)) && isSpace((token[6]))) {
+    bool failed = false;
+    if (parseShapeStatement(token, state, v, vn, vt, materials, readMatFn,
+                            err, triangulate, failed)) {
+      if (failed)
+        return false;
+      continue;
+    }
 
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 7;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
+    // Ignore unknown command.
+  }
 
-      // Create face group per material.
-      bool ret =
-          exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, tags,
-                                 material, name, true, triangulate);
-      if (ret) {
-        shapes.push_back(shape);
-      }
-      shape = shape_t();
-      faceGroup.clear();
-
-      if (material_map.find(namebuf) != material_map.end()) {
-        material = material_map[namebuf];
-      } else {
-        // { error!! material not found }
-        material = -1;
-      }
+  flushFaceGroup(state, v, vn, vt, triangulate);
 
-      continue;
-    }
+  err += errss.str();
+  return true;
+}
 
-    // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && isSpace((token[6]))) {
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 7;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
+bool LoadObj(std::vector<shape_t> &shapes,       // [output]
+             std::vector<material_t> &materials, // [output]
+             std::string &err, std::istream &inStream,
+             MaterialReader &readMatFn, bool triangulate) {
+  obj_parse_state state;
+  state.shapes = &shapes;
+  return LoadObjSerial(state, materials, err, inStream, readMatFn,
+                       triangulate);
+}
 
-      std::string err_mtl;
-      bool ok = readMatFn(namebuf, materials, material_map, err_mtl);
-      err += err_mtl;
+bool LoadObjStreaming(const shape_callback &callback,
+                      std::vector<material_t> &materials, std::string &err,
+                      const char *filename, const char *mtl_basepath,
+                      bool triangulate, std::vector<std::string> *mtl_files) {
+  std::ifstream ifs(filename);
+  if (!ifs) {
+    std::stringstream errss;
+    errss << "Cannot open file [" << filename << "]" << std::endl;
+    err = errss.str();
+    return false;
+  }
 
-      if (!ok) {
-        faceGroup.clear(); // for safety
-        return false;
-      }
+  std::string basePath;
+  if (mtl_basepath) {
+    basePath = mtl_basepath;
+  }
+  MaterialFileReader matFileReader(basePath, mtl_files);
 
-      continue;
-    }
+  obj_parse_state state;
+  state.callback = &callback;
+  return LoadObjSerial(state, materials, err, ifs, matFileReader,
+                       triangulate);
+}
 
-    // group name
-    if (token[0] == 'g' && isSpace((token[1]))) {
+// Parallel parsing.
+//
+// The file is read in to memory and split in to chunks at line boundaries.
+// A first pass over every chunk terminates each line and counts its v/vn/vt
+// records, so every chunk knows how many of them precede it in the file. A
+// second pass tokenises each chunk on its own thread, writing vertex data
+// straight in to the shared arrays and resolving face indices (including
+// relative ones) against the global counts. Statements that have to be
+// applied in order (usemtl, mtllib, g, o, t) and the faces are then replayed
+// on the calling thread, so the output is identical to the serial parser.
+
+// Minimum number of bytes given to each thread.
+#ifndef TINYOBJ_PARALLEL_MIN_CHUNK_SIZE
+#define TINYOBJ_PARALLEL_MIN_CHUNK_SIZE (256 * 1024)
+#endif
 
-      // flush previous face group.
-      bool ret =
-          exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, tags,
-                                 material, name, true, triangulate);
-      if (ret) {
-        shapes.push_back(shape);
-      }
+struct obj_command {
+  enum type_t { FACE, STATEMENT };
 
-      shape = shape_t();
+  type_t type;
+  const char *line;  // STATEMENT
+  size_t first_index; // FACE, into obj_chunk::face_indices
+  size_t num_indices; // FACE
+};
 
-      // material = -1;
-      faceGroup.clear();
+struct obj_chunk {
+  char *begin;
+  char *end;
 
-      std::vector<std::string> names;
-      while (!isNewLine(token[0])) {
-        std::string str = parseString(token);
-        names.push_back(str);
-        token += strspn(token, " \t\r"); // skip tag
-      }
+  // counted in the first pass
+  size_t num_v, num_vn, num_vt;
+  // v/vn/vt records that appear in the file before this chunk
+  size_t first_v, first_vn, first_vt;
 
-      assert(names.size() > 0);
+  std::vector<vertex_index> face_indices;
+  std::vector<obj_command> commands;
 
-      // names[0] must be 'g', so skip the 0th element.
-      if (names.size() > 1) {
-        name = names[1];
-      } else {
-        name = "";
-      }
+  obj_chunk()
+      : begin(NULL), end(NULL), num_v(0), num_vn(0), num_vt(0), first_v(0),
+        first_vn(0), first_vt(0) {}
+};
 
-      continue;
+// 'v' = position, 'n' = normal, 't' = texcoord, 0 = anything else.
+static inline char vertexRecordType(const char *token) {
+  if (token[0] != 'v')
+    return 0;
+  if (isSpace(token[1]))
+    return 'v';
+  if (token[1] == 'n' && isSpace(token[2]))
+    return 'n';
+  if (token[1] == 't' && isSpace(token[2]))
+    return 't';
+  return 0;
+}
+
+// Null terminates every line in the chunk and counts its vertex records.
+static void countChunk(obj_chunk &chunk) {
+  char *line = chunk.begin;
+  while (line < chunk.end) {
+    char *eol = static_cast<char *>(
+        memchr(line, '\n', static_cast<size_t>(chunk.end - line)));
+    if (!eol)
+      eol = chunk.end;
+
+    *eol = '\0';
+    // Trim '\r\n'
+    if (eol > line && eol[-1] == '\r')
+      eol[-1] = '\0';
+
+    const char *token = line + strspn(line, " \t");
+    switch (vertexRecordType(token)) {
+    case 'v':
+      chunk.num_v++;
+      break;
+    case 'n':
+      chunk.num_vn++;
+      break;
+    case 't':
+      chunk.num_vt++;
+      break;
+    default:
+      break;
     }
 
-    // object name
-    if (token[0] == 'o' && isSpace((token[1]))) {
+    line = eol + 1;
+  }
+}
 
-      // flush previous face group.
-      bool ret =
-          exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, tags,
-                                 material, name, true, triangulate);
-      if (ret) {
-        shapes.push_back(shape);
-      }
+static void parseChunk(obj_chunk &chunk, std::vector<float> &v,
+                       std::vector<float> &vn, std::vector<float> &vt) {
+  size_t iv = chunk.first_v;
+  size_t ivn = chunk.first_vn;
+  size_t ivt = chunk.first_vt;
 
-      // material = -1;
-      faceGroup.clear();
-      shape = shape_t();
+  const char *line = chunk.begin;
+  while (line < chunk.end) {
+    const char *next = line + strlen(line) + 1;
 
-      // @todo { multiple object name? }
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 2;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
-      name = std::string(namebuf);
+    // Skip leading space.
+    const char *token = line + strspn(line, " \t");
+    line = next;
+
+    if (token[0] == '\0')
+      continue; // empty line
+
+    if (token[0] == '#')
+      continue; // comment line
 
+    switch (vertexRecordType(token)) {
+    case 'v':
+      token += 2;
+      parseFloat3(v[iv * 3 + 0], v[iv * 3 + 1], v[iv * 3 + 2], token);
+      iv++;
+      continue;
+    case 'n':
+      token += 3;
+      parseFloat3(vn[ivn * 3 + 0], vn[ivn * 3 + 1], vn[ivn * 3 + 2], token);
+      ivn++;
       continue;
+    case 't':
+      token += 3;
+      parseFloat2(vt[ivt * 2 + 0], vt[ivt * 2 + 1], token);
+      ivt++;
+      continue;
+    default:
+      break;
     }
 
-    if (token[0] == 't' && isSpace(token[1])) {
-      tag_t tag;
+    obj_command command;
 
-      char namebuf[4096];
+    // face
+    if (token[0] == 'f' && isSpace((token[1]))) {
       token += 2;
-      sscanf_s(token, "%s", namebuf, 4096);
-      tag.name = std::string(namebuf);
+      token += strspn(token, " \t");
 
-      token += tag.name.size() + 1;
+      command.type = obj_command::FACE;
+      command.line = NULL;
+      command.first_index = chunk.face_indices.size();
+      while (!isNewLine(token[0])) {
+        vertex_index vi = parseTriple(token, static_cast<int>(iv),
+                                      static_cast<int>(ivn),
+                                      static_cast<int>(ivt));
+        chunk.face_indices.push_back(vi);
+        size_t n = strspn(token, " \t\r");
+        token += n;
+      }
+      command.num_indices = chunk.face_indices.size() - command.first_index;
 
-      tag_sizes ts = parseTagTriple(token);
+      // a face needs at least three corners, drop points and lines
+      if (command.num_indices < 3) {
+        chunk.face_indices.resize(command.first_index);
+        continue;
+      }
 
-      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+      chunk.commands.push_back(command);
+      continue;
+    }
 
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-        tag.intValues[i] = atoi(token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
+    // usemtl, mtllib, g, o, t or an unknown command, sorted out in order later
+    command.type = obj_command::STATEMENT;
+    command.line = token;
+    command.first_index = 0;
+    command.num_indices = 0;
+    chunk.commands.push_back(command);
+  }
+}
 
-      tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
-        tag.floatValues[i] = parseFloat(token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
+/// Loads .obj from a null terminated buffer holding a whole file, the buffer
+/// is modified while parsing.
+static bool LoadObjParallel(std::vector<shape_t> &shapes,
+                            std::vector<material_t> &materials,
+                            std::string &err, char *buffer, size_t size,
+                            MaterialReader &readMatFn, bool triangulate,
+                            unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  size_t max_chunks = size / TINYOBJ_PARALLEL_MIN_CHUNK_SIZE;
+  if (num_threads > max_chunks) {
+    num_threads = static_cast<unsigned int>(max_chunks);
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
 
-      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        char stringValueBuffer[4096];
+  // Split at line boundaries.
+  std::vector<obj_chunk> chunks(num_threads);
+  char *buffer_end = buffer + size;
+  char *chunk_begin = buffer;
+  for (size_t t = 0; t < num_threads; t++) {
+    char *chunk_end = buffer + (size * (t + 1)) / num_threads;
+    if (chunk_end < chunk_begin)
+      chunk_end = chunk_begin;
+    if (t + 1 == num_threads) {
+      chunk_end = buffer_end;
+    } else {
+      while (chunk_end > buffer && chunk_end < buffer_end &&
+             chunk_end[-1] != '\n')
+        chunk_end++;
+    }
+    chunks[t].begin = chunk_begin;
+    chunks[t].end = chunk_end;
+    chunk_begin = chunk_end;
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(num_threads);
+
+  // First pass, split lines and count vertex records.
+  for (size_t t = 1; t < num_threads; t++)
+    workers.push_back(std::thread(countChunk, std::ref(chunks[t])));
+  countChunk(chunks[0]);
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+  workers.clear();
+
+  size_t num_v = 0, num_vn = 0, num_vt = 0;
+  for (size_t t = 0; t < num_threads; t++) {
+    chunks[t].first_v = num_v;
+    chunks[t].first_vn = num_vn;
+    chunks[t].first_vt = num_vt;
+    num_v += chunks[t].num_v;
+    num_vn += chunks[t].num_vn;
+    num_vt += chunks[t].num_vt;
+  }
 
-        sscanf_s(token, "%s", stringValueBuffer, 4096);
-        tag.stringValues[i] = stringValueBuffer;
-        token += tag.stringValues[i].size() + 1;
+  std::vector<float> v(num_v * 3);
+  std::vector<float> vn(num_vn * 3);
+  std::vector<float> vt(num_vt * 2);
+
+  // Second pass, tokenise.
+  for (size_t t = 1; t < num_threads; t++)
+    workers.push_back(std::thread(parseChunk, std::ref(chunks[t]), std::ref(v),
+                                  std::ref(vn), std::ref(vt)));
+  parseChunk(chunks[0], v, vn, vt);
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+  workers.clear();
+
+  // Stitch the faces and statements back together in file order.
+  obj_parse_state state;
+  state.shapes = &shapes;
+  for (size_t t = 0; t < num_threads; t++) {
+    obj_chunk &chunk = chunks[t];
+    for (size_t c = 0; c < chunk.commands.size(); c++) {
+      const obj_command &command = chunk.commands[c];
+
+      if (command.type == obj_command::FACE) {
+        state.faceGroup.push_back(
+            chunk.face_indices.data() + command.first_index,
+            command.num_indices);
+        continue;
       }
 
-      tags.push_back(tag);
+      bool failed = false;
+      parseShapeStatement(command.line, state, v, vn, vt, materials,
+                          readMatFn, err, triangulate, failed);
+      if (failed)
+        return false;
     }
 
-    // Ignore unknown command.
+    // release the chunk's faces as soon as they have been used
+    std::vector<vertex_index>().swap(chunk.face_indices);
+    std::vector<obj_command>().swap(chunk.commands);
   }
 
-  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup,
-                                    tags, material, name, true, triangulate);
-  if (ret) {
-    shapes.push_back(shape);
-  }
-  faceGroup.clear(); // for safety
+  flushFaceGroup(state, v, vn, vt, triangulate);
 
-  err += errss.str();
   return true;
 }
 
+bool LoadObj(std::vector<shape_t> &shapes,       // [output]
+             std::vector<material_t> &materials, // [output]
+             std::string &err, const char *filename, const char *mtl_basepath,
+             bool trianglulate, unsigned int num_threads,
+             std::vector<std::string> *mtl_files) {
+
+  shapes.clear();
+
+  std::stringstream errss;
+
+  std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+  if (!ifs) {
+    errss << "Cannot open file [" << filename << "]" << std::endl;
+    err = errss.str();
+    return false;
+  }
+
+  std::string basePath;
+  if (mtl_basepath) {
+    basePath = mtl_basepath;
+  }
+  MaterialFileReader matFileReader(basePath, mtl_files);
+
+  // Read the whole file, plus a terminator.
+  ifs.seekg(0, std::ios::end);
+  std::streamoff size = ifs.tellg();
+  ifs.seekg(0, std::ios::beg);
+  if (size < 0) {
+    errss << "Cannot read file [" << filename << "]" << std::endl;
+    err = errss.str();
+    return false;
+  }
+
+  std::vector<char> buffer(static_cast<size_t>(size) + 1, '\0');
+  ifs.read(&buffer[0], size);
+  if (ifs.gcount() != size) {
+    errss << "Cannot read file [" << filename << "]" << std::endl;
+    err = errss.str();
+    return false;
+  }
+  ifs.close();
+
+  return LoadObjParallel(shapes, materials, err, &buffer[0],
+                         static_cast<size_t>(size), matFileReader,
+                         trianglulate, num_threads);
+}
+
 } // namespace
 
 #endif
@@ -0,0 +1,250 @@
+#include "LightClustersBenchmark.h"
+#include "LightClusters.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const glm::vec2		VIEWPORT_SIZE(1280, 720);
+const float			NEAR_PLANE = 0.1f;
+const float			FAR_PLANE = 100.0f;
+
+// points tested against findCluster() and the lights reaching them
+const unsigned int	POINT_COUNT = 50000;
+
+// light counts build() is timed with, best of RUNS builds each
+const unsigned int	TIMED_LIGHT_COUNTS[] = { 100, 300, 500 };
+const unsigned int	RUNS = 20;
+
+// slack for where the clusters' floats and these don't round the same way
+const float			EPSILON = 1e-3f;
+
+// a fixed sequence so every run checks the same lights and points
+struct Random {
+	unsigned int state;
+
+	explicit Random(unsigned int seed) : state(seed) {}
+
+	// 0 to 1
+	float next() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+	float range(float min, float max) { return min + (max - min) * next(); }
+};
+
+// point lights scattered around the origin, the first is directional and
+// the second has no attenuation, so both reach every froxel
+std::vector<aie::Light> makeLights(unsigned int count) {
+	Random random(count);
+	std::vector<aie::Light> lights(count);
+	for (auto& light : lights) {
+		light.position = glm::vec4(random.range(-20, 20), random.range(0, 10), random.range(-20, 20), 1);
+		light.attenuation = random.range(0.5f, 10.5f);
+	}
+	if (count > 0)
+		lights[0].position = glm::vec4(glm::normalize(glm::vec3(-1, -1, 0)), 0);
+	if (count > 1)
+		lights[1].attenuation = 0;
+	return lights;
+}
+
+bool isListed(const aie::LightClusters& clusters, unsigned int cluster, unsigned int light) {
+	const aie::LightClusters::ClusterRange& range = clusters.getClusterRanges()[cluster];
+	auto first = clusters.getLightIndices().begin() + range.offset;
+	auto last = first + range.count;
+	return std::find(first, last, light) != last;
+}
+
+// the ranges cover the index list in froxel order without gaps or repeats
+bool checkRanges(const aie::LightClusters& clusters, size_t lightCount) {
+
+	auto& ranges = clusters.getClusterRanges();
+	auto& indices = clusters.getLightIndices();
+	if (ranges.size() != clusters.getClusterCount()) {
+		printf("  FAILED, %zu ranges for %u froxels\n", ranges.size(), clusters.getClusterCount());
+		return false;
+	}
+
+	unsigned int offset = 0;
+	for (size_t c = 0; c < ranges.size(); ++c) {
+		if (ranges[c].offset != offset ||
+			ranges[c].offset + ranges[c].count > indices.size()) {
+			printf("  FAILED, froxel %zu's range doesn't follow the one before\n", c);
+			return false;
+		}
+		offset += ranges[c].count;
+
+		for (unsigned int i = ranges[c].offset; i < ranges[c].offset + ranges[c].count; ++i) {
+			if (indices[i] >= lightCount ||
+				std::find(indices.begin() + ranges[c].offset, indices.begin() + i, indices[i]) != indices.begin() + i) {
+				printf("  FAILED, froxel %zu lists light %u badly\n", c, indices[i]);
+				return false;
+			}
+		}
+	}
+
+	if (offset != indices.size()) {
+		printf("  FAILED, the ranges cover %u of %zu indices\n", offset, indices.size());
+		return false;
+	}
+	return true;
+}
+
+// finds each point's froxel from its ndc position and depth, then checks that
+// findCluster() agrees and that the froxel lists every light reaching the point
+bool checkPoints(const aie::LightClusters& clusters, const std::vector<aie::Light>& lights,
+				 const glm::mat4& view, const glm::mat4& projection) {
+
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	glm::mat4 inverseView = glm::inverse(view);
+	float depthRange = std::log(FAR_PLANE / NEAR_PLANE);
+
+	std::vector<float> radii(lights.size());
+	for (size_t i = 0; i < lights.size(); ++i)
+		radii[i] = aie::LightClusters::getLightRadius(lights[i], clusters.getMinAttenuation());
+
+	Random random(1);
+	unsigned int tested = 0, wrongCluster = 0, missing = 0;
+	for (unsigned int p = 0; p < POINT_COUNT; ++p) {
+		glm::vec4 ndc(random.range(-1, 1), random.range(-1, 1), random.range(-1, 1), 1);
+		glm::vec4 position = inverseProjection * ndc;
+		glm::vec3 viewPosition = glm::vec3(position) / position.w;
+
+		// skip points too close to a froxel's edge to say which side they are on
+		float depth = -viewPosition.z;
+		glm::vec3 cell((ndc.x + 1) * 0.5f * clusters.getTileCountX(),
+					   (ndc.y + 1) * 0.5f * clusters.getTileCountY(),
+					   std::log(depth / NEAR_PLANE) / depthRange * clusters.getSliceCount());
+		glm::vec3 edge = glm::abs(cell - glm::round(cell));
+		if (std::min(std::min(edge.x, edge.y), edge.z) < EPSILON)
+			continue;
+		++tested;
+
+		unsigned int expected = clusters.getCluster((unsigned int)cell.x, (unsigned int)cell.y, (unsigned int)cell.z);
+		int cluster = clusters.findCluster(viewPosition);
+		if (cluster != (int)expected) {
+			if (wrongCluster++ == 0)
+				printf("  FAILED, findCluster gave %d for froxel %u\n", cluster, expected);
+			continue;
+		}
+
+		glm::vec3 worldPosition = glm::vec3(inverseView * glm::vec4(viewPosition, 1));
+		for (unsigned int i = 0; i < (unsigned int)lights.size(); ++i) {
+			bool reaches = std::isinf(radii[i]) ||
+				glm::length(glm::vec3(lights[i].position) - worldPosition) < radii[i] * (1 - EPSILON);
+			if (reaches &&
+				isListed(clusters, expected, i) == false) {
+				if (missing++ == 0)
+					printf("  FAILED, froxel %u doesn't list light %u\n", expected, i);
+			}
+		}
+	}
+
+	printf("  %u points: %u in the wrong froxel, %u lights missing\n", tested, wrongCluster, missing);
+	return wrongCluster == 0 &&
+		missing == 0;
+}
+
+// every listed light's sphere has to touch the froxel's view space box, built
+// here from the projection rather than taken from the clusters
+bool checkFroxels(const aie::LightClusters& clusters, const std::vector<aie::Light>& lights,
+				  const glm::mat4& view, const glm::mat4& projection) {
+
+	unsigned int tilesX = clusters.getTileCountX();
+	unsigned int tilesY = clusters.getTileCountY();
+	unsigned int slices = clusters.getSliceCount();
+	glm::mat4 inverseProjection = glm::inverse(projection);
+
+	auto cornerDirection = [&](unsigned int x, unsigned int y) {
+		glm::vec4 position = inverseProjection * glm::vec4(-1.0f + 2.0f * x / tilesX, -1.0f + 2.0f * y / tilesY, -1, 1);
+		return glm::vec3(position) / -position.z;
+	};
+
+	std::vector<glm::vec3> centres(lights.size());
+	std::vector<float> radii(lights.size());
+	for (size_t i = 0; i < lights.size(); ++i) {
+		centres[i] = glm::vec3(view * glm::vec4(glm::vec3(lights[i].position), 1));
+		radii[i] = aie::LightClusters::getLightRadius(lights[i], clusters.getMinAttenuation());
+	}
+
+	unsigned int listed = 0, outside = 0, touching = 0;
+	for (unsigned int slice = 0; slice < slices; ++slice) {
+		float depths[2] = {
+			NEAR_PLANE * std::pow(FAR_PLANE / NEAR_PLANE, (float)slice / slices),
+			NEAR_PLANE * std::pow(FAR_PLANE / NEAR_PLANE, (float)(slice + 1) / slices),
+		};
+
+		for (unsigned int y = 0; y < tilesY; ++y) {
+			for (unsigned int x = 0; x < tilesX; ++x) {
+				glm::vec3 boxMin(INFINITY), boxMax(-INFINITY);
+				for (unsigned int corner = 0; corner < 4; ++corner) {
+					glm::vec3 direction = cornerDirection(x + (corner & 1), y + (corner >> 1));
+					for (float depth : depths) {
+						boxMin = glm::min(boxMin, direction * depth);
+						boxMax = glm::max(boxMax, direction * depth);
+					}
+				}
+
+				unsigned int cluster = clusters.getCluster(x, y, slice);
+				for (unsigned int i = 0; i < (unsigned int)lights.size(); ++i) {
+					bool touches = std::isinf(radii[i]);
+					if (touches == false) {
+						glm::vec3 offset = glm::clamp(centres[i], boxMin, boxMax) - centres[i];
+						float radius = radii[i] * (1 + EPSILON) + EPSILON;
+						touches = glm::dot(offset, offset) <= radius * radius;
+					}
+					touching += touches ? 1 : 0;
+
+					if (isListed(clusters, cluster, i)) {
+						++listed;
+						if (touches == false &&
+							outside++ == 0)
+							printf("  FAILED, froxel %u lists light %u whose sphere misses it\n", cluster, i);
+					}
+				}
+			}
+		}
+	}
+
+	// fewer are listed than touch the boxes, as the boxes are bigger than
+	// the froxels and the clusters also cull by each light's screen extent
+	printf("  %u froxels: %u lights listed, %u touching the boxes, %u listed outside\n",
+		   clusters.getClusterCount(), listed, touching, outside);
+	return outside == 0;
+}
+
+} // namespace
+
+bool runLightClustersBenchmark() {
+
+	glm::mat4 view = glm::lookAt(glm::vec3(10, 10, 10), glm::vec3(0), glm::vec3(0, 1, 0));
+	glm::mat4 projection = glm::perspective(glm::pi<float>() * 0.25f, VIEWPORT_SIZE.x / VIEWPORT_SIZE.y, NEAR_PLANE, FAR_PLANE);
+
+	printf("light clusters benchmark\n");
+
+	aie::LightClusters clusters;
+	std::vector<aie::Light> lights = makeLights(300);
+	clusters.build(lights.data(), lights.size(), view, projection, VIEWPORT_SIZE);
+
+	bool passed = checkRanges(clusters, lights.size());
+	passed = checkPoints(clusters, lights, view, projection) && passed;
+	passed = checkFroxels(clusters, lights, view, projection) && passed;
+
+	for (unsigned int lightCount : TIMED_LIGHT_COUNTS) {
+		lights = makeLights(lightCount);
+		float best = 0;
+		for (unsigned int run = 0; run < RUNS; ++run) {
+			clusters.build(lights.data(), lights.size(), view, projection, VIEWPORT_SIZE);
+			if (run == 0 || clusters.getBuildMilliseconds() < best)
+				best = clusters.getBuildMilliseconds();
+		}
+		printf("  build with %u lights %.3fms, %zu indices\n", lightCount, best, clusters.getLightIndices().size());
+	}
+
+	return passed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// builds aie::LightClusters for a fixed set of lights and checks the result
+// against brute force, that findCluster() agrees with the froxel found from
+// the projection, that every light reaching a point is listed by the point's
+// froxel, and that no froxel lists a light whose sphere misses its box
+// then times build() for a few hundred lights
+// returns false if any check fails
+bool runLightClustersBenchmark();
@@ -0,0 +1,196 @@
+#include "LoadBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// the benchmark needs the loader's internals, so it gets its own copy
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+namespace {
+
+const char* MESHES[] = {
+	"../bin/soulspear/soulspear.obj",
+	"../bin/stanford/Bunny.obj",
+	"../bin/stanford/Dragon.obj",
+	"../bin/stanford/Buddha.obj",
+	"../bin/stanford/Lucy.obj",
+};
+
+// best of this many runs
+const unsigned int	RUNS = 5;
+
+// quads along each side of the generated grid, two million triangles
+const unsigned int	GRID_SIZE = 1000;
+
+template <typename Function>
+float bestMilliseconds(Function function) {
+	float best = 0;
+	for (unsigned int run = 0; run < RUNS; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (run == 0 || milliseconds < best)
+			best = milliseconds;
+	}
+	return best;
+}
+
+// the ordering the loader's std::map used
+struct VertexIndexLess {
+	bool operator () (const tinyobj::vertex_index& a, const tinyobj::vertex_index& b) const {
+		if (a.v_idx != b.v_idx)
+			return a.v_idx < b.v_idx;
+		if (a.vn_idx != b.vn_idx)
+			return a.vn_idx < b.vn_idx;
+		return a.vt_idx < b.vt_idx;
+	}
+};
+
+// every face corner in the file, as the loader resolves them
+bool readCorners(const char* filename, std::vector<tinyobj::vertex_index>& corners) {
+
+	std::ifstream file(filename);
+	if (!file)
+		return false;
+
+	int v = 0, vn = 0, vt = 0;
+	std::string line;
+	while (std::getline(file, line)) {
+		const char* token = line.c_str();
+		token += strspn(token, " \t");
+
+		if (token[0] == 'v' && tinyobj::isSpace(token[1]))
+			++v;
+		else if (token[0] == 'v' && token[1] == 'n' && tinyobj::isSpace(token[2]))
+			++vn;
+		else if (token[0] == 'v' && token[1] == 't' && tinyobj::isSpace(token[2]))
+			++vt;
+		else if (token[0] == 'f' && tinyobj::isSpace(token[1])) {
+			token += 2;
+			token += strspn(token, " \t");
+			while (tinyobj::isNewLine(token[0]) == false) {
+				corners.push_back(tinyobj::parseTriple(token, v, vn, vt));
+				token += strspn(token, " \t\r");
+			}
+		}
+	}
+	return true;
+}
+
+size_t weldMap(const std::vector<tinyobj::vertex_index>& corners) {
+	std::map<tinyobj::vertex_index, unsigned int, VertexIndexLess> cache;
+	for (auto& corner : corners)
+		cache.insert(std::make_pair(corner, (unsigned int)cache.size()));
+	return cache.size();
+}
+
+size_t weldTable(tinyobj::vertex_cache& cache, const std::vector<tinyobj::vertex_index>& corners) {
+	cache.clear();
+	unsigned int count = 0;
+	for (auto& corner : corners) {
+		bool inserted = false;
+		cache.find_or_insert(corner, count, inserted);
+		if (inserted)
+			++count;
+	}
+	return count;
+}
+
+// the corners of a grid of quads split in to triangles, each vertex is shared
+// by up to six triangles like a scanned mesh, which soulspear's aren't
+void makeGridCorners(unsigned int size, std::vector<tinyobj::vertex_index>& corners) {
+	auto vertex = [size](unsigned int x, unsigned int y) {
+		int i = (int)(x + (size + 1) * y);
+		return tinyobj::vertex_index(i, -1, i);
+	};
+	for (unsigned int y = 0; y < size; ++y) {
+		for (unsigned int x = 0; x < size; ++x) {
+			tinyobj::vertex_index quad[] = {
+				vertex(x, y), vertex(x + 1, y), vertex(x + 1, y + 1),
+				vertex(x, y), vertex(x + 1, y + 1), vertex(x, y + 1),
+			};
+			corners.insert(corners.end(), quad, quad + 6);
+		}
+	}
+}
+
+bool compareWelds(const std::vector<tinyobj::vertex_index>& corners) {
+
+	size_t mapVertices = 0, tableVertices = 0;
+	tinyobj::vertex_cache cache;
+	float mapMilliseconds = bestMilliseconds([&]() { mapVertices = weldMap(corners); });
+	float tableMilliseconds = bestMilliseconds([&]() { tableVertices = weldTable(cache, corners); });
+
+	printf("    weld std::map %.2fms, vertex_cache %.2fms (%.1fx), %zu vertices\n",
+		   mapMilliseconds, tableMilliseconds, mapMilliseconds / std::max(tableMilliseconds, 0.001f), tableVertices);
+
+	if (mapVertices != tableVertices) {
+		printf("    FAILED, std::map welded %zu vertices\n", mapVertices);
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+bool runLoadBenchmark() {
+
+	bool passed = true;
+	unsigned int found = 0;
+
+	printf("load benchmark, best of %u runs\n", RUNS);
+	for (const char* filename : MESHES) {
+
+		std::vector<tinyobj::vertex_index> corners;
+		if (readCorners(filename, corners) == false) {
+			printf("  %s: not found, skipped\n", filename);
+			continue;
+		}
+		++found;
+
+		std::string folder(filename, strrchr(filename, '/') + 1);
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string error;
+		bool loaded = true;
+
+		auto load = [&](unsigned int threads) {
+			return bestMilliseconds([&]() {
+				materials.clear();
+				loaded = tinyobj::LoadObj(shapes, materials, error, filename, folder.c_str(), true, threads) && loaded;
+			});
+		};
+		float serial = load(1);
+		float parallel = load(0);
+
+		size_t indices = 0;
+		for (auto& shape : shapes)
+			indices += shape.mesh.indices.size();
+
+		printf("  %s: %zu corners, %zu indices\n", filename, corners.size(), indices);
+		printf("    LoadObj %.2fms on one thread, %.2fms on every thread\n", serial, parallel);
+		if (loaded == false) {
+			printf("    FAILED to load: %s\n", error.c_str());
+			passed = false;
+		}
+		passed = compareWelds(corners) && passed;
+	}
+
+	// stands in for the stanford models when they aren't there
+	std::vector<tinyobj::vertex_index> grid;
+	makeGridCorners(GRID_SIZE, grid);
+	printf("  %ux%u grid: %zu corners\n", GRID_SIZE, GRID_SIZE, grid.size());
+	passed = compareWelds(grid) && passed;
+
+	if (found == 0) {
+		printf("  no meshes found, set the working directory to bin\n");
+		passed = false;
+	}
+
+	return passed;
+}
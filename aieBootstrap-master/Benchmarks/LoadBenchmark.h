@@ -0,0 +1,9 @@
+#pragma once
+
+// times tinyobj loading soulspear and whichever stanford models are in
+// bin/stanford, the models are too big to keep in the repository
+// each mesh's face corners, and those of a generated grid shaped like a
+// scanned mesh, are also welded with the std::map the loader used to use and
+// with tinyobj::vertex_cache, to show what the table saves
+// returns false if a mesh fails to load or the two welds disagree
+bool runLoadBenchmark();
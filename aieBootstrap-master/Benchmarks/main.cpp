@@ -0,0 +1,31 @@
+#include "LightClustersBenchmark.h"
+#include "LoadBenchmark.h"
+#include <cstdio>
+#include <cstring>
+
+// runs the benchmarks named on the command line, or all of them
+// returns non-zero if any of their checks failed
+int main(int argc, char* argv[]) {
+
+	struct Benchmark {
+		const char*	name;
+		bool		(*run)();
+	};
+	const Benchmark benchmarks[] = {
+		{ "load", runLoadBenchmark },
+		{ "clusters", runLightClustersBenchmark },
+	};
+
+	bool passed = true;
+	for (auto& benchmark : benchmarks) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i)
+			selected = selected || strcmp(argv[i], benchmark.name) == 0;
+
+		if (selected)
+			passed = benchmark.run() && passed;
+	}
+
+	printf(passed ? "passed\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
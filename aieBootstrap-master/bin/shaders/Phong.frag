@@ -2,7 +2,7 @@
 	\file phong.frag
 	\brief A normal map fragment shader
 */
-#version 410
+#version 430
 
 /*
 	\var vec4 fragPosition
@@ -23,50 +23,89 @@ in vec3 fragTangent;
 in vec3 fragBiTangent;
 
 /*
-	\def MAX_LIGHTS 10
-	The maximum amount of lights.
-	\var int numLights
-	The number of lights.
 	\struct Light
 	\brief An object that emits light.
 	\var vec4 position
 	The position of the light.
 	\var vec3 Ia
 	The ambient colour of the light.
+	\var float attenuation
+	The reduction of the intensity of the light over distance.
 	\var vec3 Id
 	The diffuse colour of the light.
 	\var vec3 Is
 	The specular colour of the light.
-	\var float attenuation
-	The reduction of the intensity of the light over distance.
+	\var int numLights
+	The number of lights.
+	\var int clustered
+	Non zero when each pixel only shades the lights listed for its cluster.
+	\var float minAttenuation
+	Attenuation at which a clustered point light stops reaching, it is faded out towards it so the cluster edges don't show.
+	\var uvec4 clusterGrid
+	The number of tiles across and up the screen and the number of depth slices.
+	\var vec4 clusterScale
+	Scales a pixel position into a tile (xy), and the log of a depth into a slice (z * log(depth) + w).
 	\var Light[] allLights
-	All of the lights acting on the object.
+	All of the lights acting on the object, read from a buffer filled once a frame.
 */
-#define MAX_LIGHTS 10
-uniform int numLights;
-uniform struct Light
+struct Light
 {
    vec4 position;
    vec3 Ia;
+   float attenuation;
    vec3 Id;
    vec3 Is;
-   float attenuation;
-} allLights[MAX_LIGHTS];
+};
+layout(std430, binding = 1) readonly buffer Lights
+{
+	int numLights;
+	int clustered;
+	float minAttenuation;
+	uvec4 clusterGrid;
+	vec4 clusterScale;
+	Light allLights[];
+};
+
+/*
+	\var uvec2[] clusterLights
+	The offset into lightIndices and the number of lights of each cluster, ordered by tile x, then tile y, then slice.
+	\var uint[] lightIndices
+	The lights of every cluster.
+*/
+layout(std430, binding = 2) readonly buffer LightClusterRanges
+{
+	uvec2 clusterLights[];
+};
+layout(std430, binding = 3) readonly buffer LightClusterIndices
+{
+	uint lightIndices[];
+};
 
 /*
+	\struct Material
+	\brief The material of the mesh chunk being drawn, read from a uniform buffer holding all of the mesh's materials.
 	\var vec3 Ka
 	Ambient light from the material.
+	\var float opacity
+	Opacity of the material.
 	\var vec3 Kd
 	Diffuse light from the material.
-	\var vec3 Ks
-	Specular light from the material.
 	\var float specularPower
 	Specular power from the material.
+	\var vec3 Ks
+	Specular light from the material.
+	\var vec3 Ke
+	Emissive light from the material.
 */
-uniform vec3 Ka;
-uniform vec3 Kd;
-uniform vec3 Ks;
-uniform float specularPower;
+layout(std140) uniform Material
+{
+	vec3 Ka;
+	float opacity;
+	vec3 Kd;
+	float specularPower;
+	vec3 Ks;
+	vec3 Ke;
+};
 
 /*
 	\var vec3 cameraPosition
@@ -126,6 +165,11 @@ vec3 ApplyLight(Light light, vec3 diffuseColor, vec3 specularColour, vec3 normal
         float distanceToLight = length(light.position.xyz - surfacePos);
 		// determines the remaining intensity of the light based on the distance
         attenuation = 1.0f / (1.0f + light.attenuation * pow(distanceToLight, 2));
+		// fades to nothing where the light leaves the clusters it was binned in to
+		if (clustered != 0)
+		{
+			attenuation = max((attenuation - minAttenuation) / (1.0f - minAttenuation), 0.0f);
+		}
     }
 
     // ambient component
@@ -173,10 +217,25 @@ void main()
 
     // combine color from all the lights
     vec3 linearColour = vec3(0);
-    for (int i = 0; i < numLights; i++)
+	if (clustered != 0)
 	{
-		linearColour += ApplyLight(allLights[i], texDiffuse.rgb, texSpecular.rgb, normal, surfacePos, surfaceToCamera);
-    }
+		// finds the cluster of the pixel from its screen position and view depth
+		vec3 cell = vec3(gl_FragCoord.xy * clusterScale.xy, log(1.0f / gl_FragCoord.w) * clusterScale.z + clusterScale.w);
+		uvec3 tile = uvec3(clamp(cell, vec3(0), vec3(clusterGrid.xyz) - 1));
+		uvec2 range = clusterLights[tile.x + clusterGrid.x * (tile.y + clusterGrid.y * tile.z)];
+		// only the lights that reach the cluster
+		for (uint i = range.x; i < range.x + range.y; i++)
+		{
+			linearColour += ApplyLight(allLights[lightIndices[i]], texDiffuse.rgb, texSpecular.rgb, normal, surfacePos, surfaceToCamera);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < numLights; i++)
+		{
+			linearColour += ApplyLight(allLights[i], texDiffuse.rgb, texSpecular.rgb, normal, surfacePos, surfaceToCamera);
+		}
+	}
     
     // final color (after gamma correction)
     vec3 gamma = vec3(1.0f / 2.2f);
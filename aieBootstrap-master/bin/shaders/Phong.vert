@@ -1,8 +1,11 @@
 /*
 	\file phong.vert
 	\brief A normal map vertex shader.
+
+	When INSTANCED is defined, e.g. by passing "#define INSTANCED" to ShaderProgram::loadShader,
+	it draws many copies of a mesh, each with its own transform read from the Instances block.
 */
-#version 410
+#version 430
 
 /*
 	\var vec4 vertPosition
@@ -13,11 +16,23 @@
 	Texture coordinate of the vertex being passed in by the vertex array.
 	\var vec4 vertTangent
 	Tangent (along the x axis,) to the normal of the vertex being passed in by the vertex array.
+
+	\var vec3 chunkPositionOffset
+	Minimum corner of the mesh chunk bounds, used to unpack the position.
+	\var vec3 chunkPositionScale
+	Size of the mesh chunk bounds, used to unpack the position.
+
+	When PackedVertices is set the position is normalised to the mesh chunk bounds with the
+	tangent handedness in w, and the normal and tangent are octahedral encoded in xy.
+	The chunk bounds are the same for every vertex of a draw, they come from the chunk's
+	record in the geometry arena.
 */
 layout(location = 0) in vec4 vertPosition;
 layout(location = 1) in vec4 vertNormal;
 layout(location = 2) in vec2 vertTexCoord;
 layout(location = 3) in vec4 vertTangent;
+layout(location = 4) in vec3 chunkPositionOffset;
+layout(location = 5) in vec3 chunkPositionScale;
 
 /*
 	\var vec4 fragPosition
@@ -37,6 +52,33 @@ out vec2 fragTexCoord;
 out vec3 fragTangent;
 out vec3 fragBiTangent;
 
+#ifdef INSTANCED
+/*
+	\var mat4 ProjectionView
+	Used to move world-space vertices into clip space.
+*/
+uniform mat4 ProjectionView;
+
+/*
+	\struct Instance
+	\brief The transforms of one copy of the mesh.
+	\var mat4 ModelMatrix
+	Used to move local-space vertices into world space.
+	\var mat4 NormalMatrix
+	Used to transform the normal, only the upper 3x3 is used.
+	\var Instance[] instances
+	The transforms of every copy being drawn, indexed by the instance being drawn.
+*/
+struct Instance
+{
+	mat4 ModelMatrix;
+	mat4 NormalMatrix;
+};
+layout(std430, binding = 0) readonly buffer Instances
+{
+	Instance instances[];
+};
+#else
 /*
 	\var mat4 ProjectionViewModel
 	Used to move local-space vertices into clip space.
@@ -48,19 +90,65 @@ out vec3 fragBiTangent;
 uniform mat4 ProjectionViewModel;
 uniform mat4 ModelMatrix;
 uniform mat3 NormalMatrix;
+#endif
+
+/*
+	\var bool PackedVertices
+	Whether the vertex array holds packed vertices.
+*/
+uniform bool PackedVertices = false;
+
+/*
+	\fn vec3 OctahedralDecode(vec2 e)
+	\brief Unfolds an octahedral encoded unit vector.
+	\param e The encoded vector, in a -1 to 1 range.
+	\return Returns the unit vector.
+*/
+vec3 OctahedralDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	// the lower hemisphere is folded over the diagonals
+	if (v.z < 0.0f)
+	{
+		v.xy = (1.0f - abs(v.yx)) * vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normalize(v);
+}
 
 void main()
 {
+	vec4 position = vertPosition;
+	vec3 normal = vertNormal.xyz;
+	vec4 tangent = vertTangent;
+	// unpacks the vertex
+	if (PackedVertices)
+	{
+		position = vec4(chunkPositionOffset + vertPosition.xyz * chunkPositionScale, 1.0f);
+		normal = OctahedralDecode(vertNormal.xy);
+		tangent = vec4(OctahedralDecode(vertTangent.xy), vertPosition.w * 2.0f - 1.0f);
+	}
+
+#ifdef INSTANCED
+	// the instance id doesn't include the base instance, which selects the mesh chunk
+	mat4 ModelMatrix = instances[gl_InstanceID].ModelMatrix;
+	mat3 NormalMatrix = mat3(instances[gl_InstanceID].NormalMatrix);
+
+	// transforms the position into world space before passing it to the fragment shader
+	fragPosition = ModelMatrix * position;
+	// stores the clip space position in the GLSL position constant
+	gl_Position = ProjectionView * fragPosition;
+#else
 	// stores the clip space position in the GLSL position constant
-	gl_Position = ProjectionViewModel * vertPosition;
+	gl_Position = ProjectionViewModel * position;
 	// transforms the position into world space before passing it to the fragment shader
-	fragPosition = ModelMatrix * vertPosition;
+	fragPosition = ModelMatrix * position;
+#endif
 	// transforms the normal
-	fragNormal = NormalMatrix * vertNormal.xyz;
+	fragNormal = NormalMatrix * normal;
 	// outputs the given texture coordinate
 	fragTexCoord = vertTexCoord;
 	// transforms the tangent
-	fragTangent = NormalMatrix * vertTangent.xyz;
+	fragTangent = NormalMatrix * tangent.xyz;
 	// gets the BiTangent from the cross product between the normal and tangent (Y = cross(Z, X))
-	fragBiTangent = cross(fragNormal, fragTangent) * vertTangent.w;
+	fragBiTangent = cross(fragNormal, fragTangent) * tangent.w;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Gizmos.h"
+#include "ProgramCache.h"
 #include "gl_core_4_4.h"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -38,37 +39,42 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
                      out vec4 FragColor; \
 					 void main()	{ FragColor = vColour; }";
     
-    
-	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
-
-	glShaderSource(vs, 1, (const char**)&vsSource, 0);
-	glCompileShader(vs);
-
-	glShaderSource(fs, 1, (const char**)&fsSource, 0);
-	glCompileShader(fs);
+	// the attribute bindings are part of the key as they change the binary
+	const char* sources[] = { vsSource, fsSource, "Position", "Colour" };
 
 	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "Position");
-	glBindAttribLocation(m_shader, 1, "Colour");
-	glLinkProgram(m_shader);
-    
-	int success = GL_FALSE;
-    glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength + 1];
-        
-		glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
-		printf("Error: Failed to link Gizmo shader program!\n%s\n", infoLog);
-		delete[] infoLog;
-	}
+	ProgramCache::link(m_shader, ProgramCache::makeKey(sources, 4), [&]() {
+		unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+		unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+		glShaderSource(vs, 1, (const char**)&vsSource, 0);
+		glCompileShader(vs);
+
+		glShaderSource(fs, 1, (const char**)&fsSource, 0);
+		glCompileShader(fs);
+
+		glAttachShader(m_shader, vs);
+		glAttachShader(m_shader, fs);
+		glBindAttribLocation(m_shader, 0, "Position");
+		glBindAttribLocation(m_shader, 1, "Colour");
+		glLinkProgram(m_shader);
+
+		int success = GL_FALSE;
+		glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
+		if (success == GL_FALSE) {
+			int infoLogLength = 0;
+			glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+			char* infoLog = new char[infoLogLength + 1];
+
+			glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
+			printf("Error: Failed to link Gizmo shader program!\n%s\n", infoLog);
+			delete[] infoLog;
+		}
 
-	glDeleteShader(vs);
-	glDeleteShader(fs);
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return success == GL_TRUE;
+	});
     
     // create VBOs
 	glGenBuffers( 1, &m_lineVBO );
@@ -0,0 +1,222 @@
+#include "ProgramCache.h"
+#include "gl_core_4_4.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace aie {
+
+namespace {
+
+// a cache file is this header followed by the binary
+//
+// bump the version whenever the layout changes
+const char			CACHE_MAGIC[4] = { 'A', 'I', 'E', 'P' };
+const unsigned int	CACHE_VERSION = 1;
+const char*			CACHE_EXTENSION = ".programcache";
+
+struct CacheHeader {
+	char				magic[4];
+	unsigned int		version;
+	unsigned long long	key;
+	unsigned int		format;
+	unsigned int		length;
+};
+
+// 64 bit FNV-1a
+const unsigned long long	HASH_OFFSET = 14695981039346656037ull;
+const unsigned long long	HASH_PRIME = 1099511628211ull;
+
+unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size) {
+	auto bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * HASH_PRIME;
+	return hash;
+}
+
+// includes the terminator so consecutive strings can't run together
+unsigned long long hashString(unsigned long long hash, const char* string) {
+	if (string == nullptr)
+		string = "";
+	return hashBytes(hash, string, strlen(string) + 1);
+}
+
+std::string cacheFilename(const std::string& folder, unsigned long long key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", key);
+	return folder + name + CACHE_EXTENSION;
+}
+
+bool binariesSupported() {
+	int formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0;
+}
+
+bool isLinked(unsigned int program) {
+	int success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success == GL_TRUE;
+}
+
+// false if there is no usable binary for key, or the driver rejected it
+bool loadBinary(unsigned int program, const std::string& filename, unsigned long long key, bool& rejected) {
+
+	rejected = false;
+
+	FILE* file = nullptr;
+	if (fopen_s(&file, filename.c_str(), "rb") != 0)
+		return false;
+
+	CacheHeader header;
+	std::vector<char> binary;
+	bool valid = fread(&header, sizeof(CacheHeader), 1, file) == 1 &&
+		memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+		header.version == CACHE_VERSION &&
+		header.key == key &&
+		header.length > 0;
+	if (valid) {
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+
+	if (valid)
+		glProgramBinary(program, header.format, binary.data(), (int)binary.size());
+
+	if (valid == false ||
+		isLinked(program) == false) {
+		// usually a driver update that kept the same version string
+		remove(filename.c_str());
+		rejected = valid;
+		return false;
+	}
+
+	return true;
+}
+
+void saveBinary(unsigned int program, const std::string& filename, unsigned long long key) {
+
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.format = 0;
+	header.length = 0;
+
+	std::vector<char> binary(length);
+	glGetProgramBinary(program, length, &length, &header.format, binary.data());
+	if (length <= 0)
+		return;
+	header.length = (unsigned int)length;
+
+	FILE* file = nullptr;
+	if (fopen_s(&file, filename.c_str(), "wb") != 0)
+		return;
+
+	bool written = fwrite(&header, sizeof(CacheHeader), 1, file) == 1 &&
+		fwrite(binary.data(), 1, header.length, file) == header.length;
+	fclose(file);
+
+	// never leave a partial binary behind
+	if (written == false)
+		remove(filename.c_str());
+}
+
+float millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+std::string ProgramCache::sm_folder;
+bool ProgramCache::sm_enabled = true;
+ProgramCache::Stats ProgramCache::sm_stats = {};
+
+unsigned long long ProgramCache::makeKey(const char* const* sources, unsigned int sourceCount) {
+
+	unsigned long long hash = HASH_OFFSET;
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+
+	for (unsigned int i = 0; i < sourceCount; ++i) {
+		unsigned char present = sources[i] != nullptr ? 1 : 0;
+		hash = hashBytes(hash, &present, 1);
+		hash = hashString(hash, sources[i]);
+	}
+
+	return hash;
+}
+
+bool ProgramCache::link(unsigned int program, unsigned long long key, const std::function<bool()>& compile) {
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (load(program, key))
+		return true;
+
+	bool linked = compile();
+	if (linked)
+		store(program, key);
+
+	recordCompile(millisecondsSince(start));
+	return linked;
+}
+
+bool ProgramCache::load(unsigned int program, unsigned long long key) {
+
+	if (sm_enabled == false ||
+		binariesSupported() == false)
+		return false;
+
+	auto start = std::chrono::steady_clock::now();
+
+	bool rejected = false;
+	if (loadBinary(program, cacheFilename(sm_folder, key), key, rejected)) {
+		++sm_stats.hits;
+		sm_stats.hitMilliseconds += millisecondsSince(start);
+		return true;
+	}
+	if (rejected)
+		++sm_stats.rejected;
+
+	// has to be asked for before linking
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	return false;
+}
+
+void ProgramCache::store(unsigned int program, unsigned long long key) {
+
+	if (sm_enabled == false ||
+		binariesSupported() == false)
+		return;
+
+	saveBinary(program, cacheFilename(sm_folder, key), key);
+}
+
+void ProgramCache::recordCompile(float milliseconds) {
+	++sm_stats.compiles;
+	sm_stats.compileMilliseconds += milliseconds;
+}
+
+void ProgramCache::printStats() {
+
+	printf("program cache: %u hits in %.2fms", sm_stats.hits, sm_stats.hitMilliseconds);
+	if (sm_stats.hits > 0)
+		printf(" (%.2fms each)", sm_stats.hitMilliseconds / sm_stats.hits);
+	printf(", %u compiled in %.2fms", sm_stats.compiles, sm_stats.compileMilliseconds);
+	if (sm_stats.compiles > 0)
+		printf(" (%.2fms each)", sm_stats.compileMilliseconds / sm_stats.compiles);
+	if (sm_stats.rejected > 0)
+		printf(", %u binaries rejected", sm_stats.rejected);
+	printf("\n");
+}
+
+} // namespace aie
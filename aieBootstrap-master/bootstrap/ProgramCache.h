@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace aie {
+
+// keeps the driver's binaries of linked programs on disk, so later runs can
+// load a program with glProgramBinary instead of compiling its shaders again
+// binaries are keyed by a hash of every stage's source along with the driver's
+// vendor, renderer and version, so a new driver or an edited shader misses
+// rather than loading something stale
+// a binary the driver rejects is deleted and the program compiled as normal
+// everything here has to happen on the thread that owns the opengl context
+class ProgramCache {
+public:
+
+	// hashes the sources with the current driver's strings, null sources are
+	// hashed as missing stages, so the same sources in other stages don't match
+	// anything else that changes the program, such as attribute bindings, should
+	// be passed as another source
+	static unsigned long long makeKey(const char* const* sources, unsigned int sourceCount);
+
+	// links program from the binary cached for key, otherwise calls compile to
+	// attach its shaders and link it, caching the binary when that succeeds
+	// returns whether program ended up linked
+	static bool link(unsigned int program, unsigned long long key, const std::function<bool()>& compile);
+
+	// the steps of link() for programs that link in the background
+	// load() links program from the binary cached for key, if there isn't one
+	// it returns false having asked for the binary to be kept by the next link
+	// store() caches the binary once that link has succeeded, and
+	// recordCompile() counts the time it took
+	static bool load(unsigned int program, unsigned long long key);
+	static void store(unsigned int program, unsigned long long key);
+	static void recordCompile(float milliseconds);
+
+	// folder the binaries are kept in, including its trailing slash, it isn't
+	// created so it has to exist already
+	// empty by default, which is the working directory
+	static void setFolder(const char* folder) { sm_folder = folder; }
+	static const std::string& getFolder() { return sm_folder; }
+
+	// turns caching off, every program is compiled
+	static void setEnabled(bool enabled) { sm_enabled = enabled; }
+
+	// totals over every program linked through the cache
+	struct Stats {
+		unsigned int	hits;
+		unsigned int	compiles;
+		unsigned int	rejected;			// binaries the driver refused, also counted as compiles
+		float			hitMilliseconds;
+		float			compileMilliseconds;
+	};
+
+	static const Stats& getStats() { return sm_stats; }
+
+	// prints the totals, and how long a cache hit and a compile take on average
+	static void printStats();
+
+private:
+
+	static std::string	sm_folder;
+	static bool			sm_enabled;
+	static Stats		sm_stats;
+};
+
+} // namespace aie
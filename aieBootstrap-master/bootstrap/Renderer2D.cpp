@@ -1,6 +1,7 @@
 #include "gl_core_4_4.h"
 #include <GLFW/glfw3.h>
 #include "Renderer2D.h"
+#include "ProgramCache.h"
 #include "Texture.h"
 #include "Font.h"
 #include <glm/ext.hpp>
@@ -63,34 +64,43 @@ Renderer2D::Renderer2D() {
 							} else fragColour = vColour; \
 						if (fragColour.a < 0.001f) discard; }";
 	
-	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
-
-	glShaderSource(vs, 1, (const char**)&vertexShader, 0);
-	glCompileShader(vs);
-
-	glShaderSource(fs, 1, (const char**)&fragmentShader, 0);
-	glCompileShader(fs);
+	// the attribute bindings are part of the key as they change the binary
+	const char* sources[] = { vertexShader, fragmentShader, "position", "colour", "texcoord" };
 
 	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "position");
-	glBindAttribLocation(m_shader, 1, "colour");
-	glBindAttribLocation(m_shader, 2, "texcoord");
-	glLinkProgram(m_shader);
-
-	int success = GL_FALSE;
-	glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength];
-
-		glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
-		printf("Error: Failed to link SpriteBatch shader program!\n%s\n", infoLog);
-		delete[] infoLog;
-	}
+	ProgramCache::link(m_shader, ProgramCache::makeKey(sources, 5), [&]() {
+		unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+		unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+		glShaderSource(vs, 1, (const char**)&vertexShader, 0);
+		glCompileShader(vs);
+
+		glShaderSource(fs, 1, (const char**)&fragmentShader, 0);
+		glCompileShader(fs);
+
+		glAttachShader(m_shader, vs);
+		glAttachShader(m_shader, fs);
+		glBindAttribLocation(m_shader, 0, "position");
+		glBindAttribLocation(m_shader, 1, "colour");
+		glBindAttribLocation(m_shader, 2, "texcoord");
+		glLinkProgram(m_shader);
+
+		int success = GL_FALSE;
+		glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
+		if (success == GL_FALSE) {
+			int infoLogLength = 0;
+			glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+			char* infoLog = new char[infoLogLength];
+
+			glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
+			printf("Error: Failed to link SpriteBatch shader program!\n%s\n", infoLog);
+			delete[] infoLog;
+		}
+
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return success == GL_TRUE;
+	});
 
 	glUseProgram(m_shader);
 
@@ -102,9 +112,6 @@ Renderer2D::Renderer2D() {
 	}
 
 	glUseProgram(0);
-
-	glDeleteShader(vs);
-	glDeleteShader(fs);
 	
 	// pre calculate the indices... they will always be the same
 	int index = 0;
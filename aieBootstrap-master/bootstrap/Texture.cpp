@@ -53,45 +53,70 @@ bool Texture::load(const char* filename) {
 		m_filename = "none";
 	}
 
-	int x = 0, y = 0, comp = 0;
-	m_loadedPixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+	return decode(filename) &&
+		upload();
+}
+
+bool Texture::decode(const char* filename) {
 
 	if (m_loadedPixels != nullptr) {
-		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
-		switch (comp) {
-		case STBI_grey:
-			m_format = RED;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, x, y,
-						 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_grey_alpha:
-			m_format = RG;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, x, y,
-						 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb:
-			m_format = RGB;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y,
-						 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb_alpha:
-			m_format = RGBA;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y,
-						 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		default:	break;
-		};
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		m_width = (unsigned int)x;
-		m_height = (unsigned int)y;
-		m_filename = filename;
-		return true;
+		stbi_image_free(m_loadedPixels);
+		m_loadedPixels = nullptr;
 	}
-	return false;
+
+	int x = 0, y = 0, comp = 0;
+	m_loadedPixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+
+	if (m_loadedPixels == nullptr)
+		return false;
+
+	switch (comp) {
+	case STBI_grey:			m_format = RED;		break;
+	case STBI_grey_alpha:	m_format = RG;		break;
+	case STBI_rgb:			m_format = RGB;		break;
+	case STBI_rgb_alpha:	m_format = RGBA;	break;
+	default:				m_format = 0;		break;
+	};
+	m_width = (unsigned int)x;
+	m_height = (unsigned int)y;
+	m_filename = filename;
+	return true;
+}
+
+bool Texture::upload() {
+
+	if (m_loadedPixels == nullptr)
+		return false;
+
+	if (m_glHandle != 0)
+		glDeleteTextures(1, &m_glHandle);
+
+	glGenTextures(1, &m_glHandle);
+	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	switch (m_format) {
+	case RED:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height,
+					 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	case RG:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, m_width, m_height,
+					 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	case RGB:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height,
+					 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	case RGBA:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height,
+					 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
+		break;
+	default:	break;
+	};
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
 }
 
 void Texture::create(unsigned int width, unsigned int height, Format format, unsigned char* pixels) {
@@ -23,6 +23,12 @@ public:
 	// load a jpg, bmp, png or tga
 	bool load(const char* filename);
 
+	// load() split in two so that files can be read and decoded on another thread
+	// decode() doesn't touch opengl, upload() must be called on the thread that
+	// owns the context and creates the texture from the decoded pixels
+	bool decode(const char* filename);
+	bool upload();
+
 	// creates a texture that can be filled in with pixels
 	void create(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
 
@@ -95,6 +95,18 @@ static PROC WinGetProcAddress(const char *name)
 	#endif
 #endif
 
+int ogl_ext_KHR_parallel_shader_compile = ogl_LOAD_FAILED;
+
+void (CODEGEN_FUNCPTR *_ptrc_glMaxShaderCompilerThreadsKHR)(GLuint) = NULL;
+
+static int Load_KHR_parallel_shader_compile()
+{
+	int numFailed = 0;
+	_ptrc_glMaxShaderCompilerThreadsKHR = (void (CODEGEN_FUNCPTR *)(GLuint))IntGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	if(!_ptrc_glMaxShaderCompilerThreadsKHR) numFailed++;
+	return numFailed;
+}
+
 void (CODEGEN_FUNCPTR *_ptrc_glBlendFunc)(GLenum, GLenum) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClear)(GLbitfield) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClearColor)(GLfloat, GLfloat, GLfloat, GLfloat) = NULL;
@@ -1753,10 +1765,10 @@ typedef struct ogl_StrToExtMap_s
 } ogl_StrToExtMap;
 
 static ogl_StrToExtMap ExtensionMap[1] = {
-	{"", NULL, NULL},
+	{"GL_KHR_parallel_shader_compile", &ogl_ext_KHR_parallel_shader_compile, Load_KHR_parallel_shader_compile},
 };
 
-static int g_extensionMapSize = 0;
+static int g_extensionMapSize = 1;
 
 static ogl_StrToExtMap *FindExtEntry(const char *extensionName)
 {
@@ -1773,6 +1785,7 @@ static ogl_StrToExtMap *FindExtEntry(const char *extensionName)
 
 static void ClearExtensionVars()
 {
+	ogl_ext_KHR_parallel_shader_compile = ogl_LOAD_FAILED;
 }
 
 
@@ -153,6 +153,17 @@ typedef unsigned int GLhandleARB;
 extern "C" {
 #endif /*__cplusplus*/
 
+extern int ogl_ext_KHR_parallel_shader_compile;
+
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile 1
+extern void (CODEGEN_FUNCPTR *_ptrc_glMaxShaderCompilerThreadsKHR)(GLuint);
+#define glMaxShaderCompilerThreadsKHR _ptrc_glMaxShaderCompilerThreadsKHR
+#endif /*GL_KHR_parallel_shader_compile*/
+
 #define GL_ALPHA 0x1906
 #define GL_ALWAYS 0x0207
 #define GL_AND 0x1501